@@ -0,0 +1,115 @@
+#ifdef ALLOC_TRACK
+
+#include "alloc.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sys/resource.h>
+
+static const char *phaseNames[PHASE_COUNT] = { "startup", "prelude", "lexing", "parsing", "semantic" };
+static const char *kindNames[KIND_COUNT] = {
+    "Id", "Const", "paramNode", "headerNode", "exprNode", "fcallNode", "lvalNode", "ifNode",
+    "stmtNode", "fdefNode", "basicType", "arrayType", "refType", "SymbolPool", "strdup"
+};
+
+static std::atomic<int> currentPhase(PHASE_STARTUP);
+static std::atomic<size_t> phaseAllocs[PHASE_COUNT];
+static std::atomic<size_t> phaseBytes[PHASE_COUNT];
+static std::atomic<size_t> kindCount[KIND_COUNT];
+static std::atomic<size_t> kindBytes[KIND_COUNT];
+static std::atomic<size_t> liveBytes(0);
+static std::atomic<size_t> peakLiveBytes(0);
+
+// Every block carries its size in a header so delete can update the live total.
+static const size_t headerSize = alignof(std::max_align_t);
+
+static void noteAlloc(size_t bytes) {
+    int p = currentPhase.load(std::memory_order_relaxed);
+    phaseAllocs[p].fetch_add(1, std::memory_order_relaxed);
+    phaseBytes[p].fetch_add(bytes, std::memory_order_relaxed);
+    size_t live = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+static void *trackedAlloc(size_t bytes) {
+    char *block = static_cast<char*>(malloc(bytes + headerSize));
+    if (!block) return nullptr;
+    *reinterpret_cast<size_t*>(block) = bytes;
+    noteAlloc(bytes);
+    return block + headerSize;
+}
+
+static void trackedFree(void *p) {
+    if (!p) return;
+    char *block = static_cast<char*>(p) - headerSize;
+    liveBytes.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+    free(block);
+}
+
+AllocPhase allocSetPhase(AllocPhase p) {
+    return static_cast<AllocPhase>(currentPhase.exchange(p));
+}
+
+void allocTrackKind(AllocKind k, size_t bytes) {
+    kindCount[k].fetch_add(1, std::memory_order_relaxed);
+    kindBytes[k].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+/* Lexer strings carry the same size header, so the parser releases them with allocFree. */
+char *allocStrdup(const char *s) {
+    size_t len = strlen(s) + 1;
+    char *copy = static_cast<char*>(trackedAlloc(len));
+    if (!copy) return nullptr;
+    memcpy(copy, s, len);
+    allocTrackKind(KIND_STRDUP, len);
+    return copy;
+}
+
+void allocFree(char *s) { trackedFree(s); }
+
+void allocReport(FILE *out, bool json) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long peakRss = usage.ru_maxrss; // KB on Linux
+
+    if (json) {
+        fprintf(out, "{\"phases\": {");
+        for (int p = 0; p < PHASE_COUNT; p++)
+            fprintf(out, "%s\"%s\": {\"allocs\": %zu, \"bytes\": %zu}", p ? ", " : "", phaseNames[p],
+                    phaseAllocs[p].load(), phaseBytes[p].load());
+        fprintf(out, "}, \"classes\": {");
+        for (int k = 0; k < KIND_COUNT; k++)
+            fprintf(out, "%s\"%s\": {\"count\": %zu, \"bytes\": %zu}", k ? ", " : "", kindNames[k],
+                    kindCount[k].load(), kindBytes[k].load());
+        fprintf(out, "}, \"peakLiveBytes\": %zu, \"peakRssKB\": %ld}\n", peakLiveBytes.load(), peakRss);
+        return;
+    }
+
+    fprintf(out, "Allocations by phase:\n");
+    for (int p = 0; p < PHASE_COUNT; p++)
+        fprintf(out, "  %-12s %10zu allocs %12zu bytes\n", phaseNames[p], phaseAllocs[p].load(), phaseBytes[p].load());
+    fprintf(out, "Allocations by class:\n");
+    for (int k = 0; k < KIND_COUNT; k++)
+        fprintf(out, "  %-12s %10zu objects %11zu bytes\n", kindNames[k], kindCount[k].load(), kindBytes[k].load());
+    fprintf(out, "Peak live heap: %zu bytes\n", peakLiveBytes.load());
+    fprintf(out, "Peak RSS: %ld KB\n", peakRss);
+}
+
+void *operator new(size_t n) {
+    void *p = trackedAlloc(n);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void *operator new[](size_t n) { return operator new(n); }
+void *operator new(size_t n, const std::nothrow_t&) noexcept { return trackedAlloc(n); }
+void *operator new[](size_t n, const std::nothrow_t&) noexcept { return trackedAlloc(n); }
+
+void operator delete(void *p) noexcept { trackedFree(p); }
+void operator delete[](void *p) noexcept { trackedFree(p); }
+void operator delete(void *p, size_t) noexcept { trackedFree(p); }
+void operator delete[](void *p, size_t) noexcept { trackedFree(p); }
+void operator delete(void *p, const std::nothrow_t&) noexcept { trackedFree(p); }
+void operator delete[](void *p, const std::nothrow_t&) noexcept { trackedFree(p); }
+
+#endif
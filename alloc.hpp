@@ -0,0 +1,79 @@
+#ifndef ALLOC_HPP
+#define ALLOC_HPP
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+/*
+ * Opt-in allocation profiling. Built with -DALLOC_TRACK (make ALLOC_TRACK=1),
+ * the global operator new/delete are replaced so every heap allocation is
+ * attributed to the current compiler phase, and the AST and type classes count
+ * their heap instances in a class operator new (static and stack objects are
+ * not counted). Without the flag all hooks compile away.
+ */
+
+enum AllocPhase {
+    PHASE_STARTUP,
+    PHASE_PRELUDE,
+    PHASE_LEXING,
+    PHASE_PARSING,
+    PHASE_SEMANTIC,
+    PHASE_COUNT
+};
+
+enum AllocKind {
+    KIND_ID,
+    KIND_CONST,
+    KIND_PARAM,
+    KIND_HEADER,
+    KIND_EXPR,
+    KIND_FCALL,
+    KIND_LVAL,
+    KIND_IF,
+    KIND_STMT,
+    KIND_FDEF,
+    KIND_BASIC_TYPE,
+    KIND_ARRAY_TYPE,
+    KIND_REF_TYPE,
+    KIND_SYMBOL_POOL,
+    KIND_STRDUP,
+    KIND_COUNT
+};
+
+#ifdef ALLOC_TRACK
+
+AllocPhase allocSetPhase(AllocPhase p);
+void allocTrackKind(AllocKind k, size_t bytes);
+char *allocStrdup(const char *s);
+void allocFree(char *s);
+void allocReport(FILE *out, bool json);
+
+#define TRACK_NEW(kind) \
+    static void *operator new(size_t n) { allocTrackKind(kind, n); return ::operator new(n); } \
+    static void operator delete(void *p) { ::operator delete(p); }
+#define TRACK_BLOCK(kind, bytes) allocTrackKind(kind, bytes)
+
+#else
+
+inline AllocPhase allocSetPhase(AllocPhase p) { return p; }
+inline char *allocStrdup(const char *s) { return strdup(s); }
+inline void allocFree(char *s) { free(s); }
+inline void allocReport(FILE *out, bool) { fprintf(out, "Allocation stats unavailable: rebuild with 'make ALLOC_TRACK=1'.\n"); }
+
+#define TRACK_NEW(kind)
+#define TRACK_BLOCK(kind, bytes) ((void)0)
+
+#endif
+
+/* Attributes allocations to a phase for the lifetime of the guard. */
+class AllocPhaseGuard {
+public:
+    AllocPhaseGuard(AllocPhase p) : prev(allocSetPhase(p)) {}
+    ~AllocPhaseGuard() { allocSetPhase(prev); }
+private:
+    AllocPhase prev;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "ast.hpp"
+#include "alloc.hpp"
 #include <iostream>
 #include <vector>
 #include <string>
@@ -41,7 +42,7 @@ void headerNode::printNode(std::ostream &out) const {
 }
 
 
-exprNode::exprNode(char c, lvalNode *l, Const *con, exprNode *left, exprNode *right, bool tf) : Node(), op(c), lval(l), constant(con), leftExpr(left), rightExpr(right), tfFlag(tf) {}
+exprNode::exprNode(char c, lvalNode *l, Const *con, exprNode *left, exprNode *right, bool tf) : Node(), func(nullptr), op(c), lval(l), constant(con), leftExpr(left), rightExpr(right), tfFlag(tf) {}
 void exprNode::printNode(std::ostream &out) const {
     switch (op) {
     case 'c': out << *constant;
@@ -77,7 +78,7 @@ void exprNode::printNode(std::ostream &out) const {
 }
 
 
-fcallNode::fcallNode(Id *i) : Node(), iden(i) {}
+fcallNode::fcallNode(Id *i) : Node(), iden(i), target(nullptr) {}
 void fcallNode::printNode(std::ostream &out) const {
     out << "FuncCall(" << *iden;
     if (args) {
@@ -133,7 +134,7 @@ void ifNode::printNode(std::ostream &out) const {
 }
 
 
-stmtNode::stmtNode(std::string type, stmtNode *body, stmtNode *tail, Id *i) : Node(), stmtType(type), stmtBody(body), stmtTail(tail), tag(i) {}
+stmtNode::stmtNode(std::string type, stmtNode *body, stmtNode *tail, Id *i) : Node(), funcDef(nullptr), varType(nullptr), varNames(nullptr), ifnode(nullptr), lval(nullptr), exp(nullptr), stmtType(type), stmtBody(body), stmtTail(tail), tag(i) {}
 void stmtNode::printNode(std::ostream &out) const {
     if (stmtType == "asgn") out << *lval << " := " << *exp;
     else if (stmtType == "skip") out << "skip";
@@ -195,4 +196,93 @@ void fdefNode::printNode(std::ostream &out) const {
         current = current->stmtTail;
     }
     out << "})";
-}
\ No newline at end of file
+}
+
+/*
+ * Releasing checked subtrees (--stream, --repeat). Every node is owned by exactly
+ * one parent, except the fdefNode that exit/return statements point to, which is
+ * the function they are in.
+ */
+void freeType(typeClass *t) {
+    if (!t) return;
+    if (t->isArray()) {
+        arrayType *a = static_cast<arrayType*>(t);
+        freeType(a->getBaseType());
+        delete a->getSize();
+    }
+    else if (t->isRef()) freeType(static_cast<refType*>(t)->getBaseType());
+    delete t;
+}
+
+static void freeLval(lvalNode *l);
+
+static void freeExpr(exprNode *e) {
+    if (!e) return;
+    if (e->func) {
+        delete e->func->iden;
+        if (e->func->args)
+            for (exprNode *arg : *e->func->args) freeExpr(arg);
+        delete e->func->args;
+        delete e->func;
+    }
+    freeLval(e->lval);
+    delete e->constant;
+    freeExpr(e->leftExpr);
+    freeExpr(e->rightExpr);
+    delete e;
+}
+
+static void freeLval(lvalNode *l) {
+    if (!l) return;
+    for (exprNode *idx : *l->ind) freeExpr(idx);
+    delete l->ind;
+    delete l->ident;
+    delete l;
+}
+
+void freeHeader(headerNode *h) {
+    for (paramNode *p = h->params; p;) {
+        paramNode *tail = p->tail;
+        delete p->names;
+        freeType(p->types);
+        delete p;
+        p = tail;
+    }
+    freeType(h->headType);
+    delete h->iden;
+    delete h;
+}
+
+/* Function headers are kept unless asked for: once declared, a function stays in the symbol table. */
+void freeStmts(stmtNode *stmt, bool headers) {
+    while (stmt) {
+        stmtNode *next = stmt->stmtTail;
+        if (stmt->stmtType == "def" || stmt->stmtType == "decl") {
+            freeStmts(stmt->funcDef->body, headers);
+            if (headers) freeHeader(stmt->funcDef->head);
+            delete stmt->funcDef;
+        }
+        for (ifNode *n = stmt->ifnode; n;) {
+            ifNode *tail = n->tail;
+            freeExpr(n->cond);
+            freeStmts(n->stmt, headers);
+            delete n;
+            n = tail;
+        }
+        freeType(stmt->varType);
+        delete stmt->varNames;
+        freeLval(stmt->lval);
+        freeExpr(stmt->exp);
+        freeStmts(stmt->stmtBody, headers);
+        delete stmt->tag;
+        delete stmt;
+        stmt = next;
+    }
+}
+
+/* Frees a whole program once no symbol table refers to its headers. */
+void freeProgram(fdefNode *root) {
+    freeStmts(root->body, true);
+    freeHeader(root->head);
+    delete root;
+}
@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include "symbol.hpp"
+#include "alloc.hpp"
 
 extern int yylineno;
 
@@ -27,6 +28,7 @@ class Node {
         int lineno;
         Node() : lineno(yylineno) {}
         Node(int ln) : lineno(ln) {}
+        virtual ~Node() = default;
         virtual void printNode(std::ostream &out) const = 0;
 };
 
@@ -37,6 +39,7 @@ inline std::ostream &operator<<(std::ostream &out, const Node &ast) {
 
 class Id : public Node {
     public:
+        TRACK_NEW(KIND_ID)
         Id(std::string s);
         std::string name;
         void printNode(std::ostream &out) const override;
@@ -44,6 +47,7 @@ class Id : public Node {
 
 class Const : public Node {
     public:
+        TRACK_NEW(KIND_CONST)
         Const(int v);
         int value;
         void printNode(std::ostream &out) const override;
@@ -51,6 +55,7 @@ class Const : public Node {
 
 class paramNode : public Node {
     public:
+        TRACK_NEW(KIND_PARAM)
         paramNode(std::vector<std::string> *n, typeClass *type, paramNode *t);
         bool ref;
         std::vector<std::string> *names;
@@ -61,6 +66,7 @@ class paramNode : public Node {
 
 class headerNode : public Node {
     public:
+        TRACK_NEW(KIND_HEADER)
         headerNode(typeClass *t, paramNode *p, Id *i);
         typeClass *headType;
         paramNode *params;
@@ -70,6 +76,7 @@ class headerNode : public Node {
 
 class exprNode : public Node {
     public:
+        TRACK_NEW(KIND_EXPR)
         exprNode(char c, lvalNode *l, Const *con, exprNode *left, exprNode *right, bool tf);
         fcallNode *func;
         char op;
@@ -84,14 +91,17 @@ class exprNode : public Node {
 
 class fcallNode : public Node {
     public:
+        TRACK_NEW(KIND_FCALL)
         fcallNode(Id *i);
         std::vector<exprNode*> *args;
         Id* iden;
+        headerNode *target; // the function the semantic check resolved the call to
         void printNode(std::ostream &out) const override;
 };
 
 class lvalNode : public Node {
     public:
+        TRACK_NEW(KIND_LVAL)
         lvalNode(bool str, Id *i);
         std::vector<exprNode*> *ind;
         bool isString;
@@ -102,6 +112,7 @@ class lvalNode : public Node {
 
 class ifNode : public Node {
     public:
+        TRACK_NEW(KIND_IF)
         ifNode(exprNode *e, stmtNode *s);
         ifNode *tail;
         exprNode *cond;
@@ -111,6 +122,7 @@ class ifNode : public Node {
 
 class stmtNode : public Node {
     public:
+        TRACK_NEW(KIND_STMT)
         stmtNode(std::string type, stmtNode *body, stmtNode *tail, Id *i);
         fdefNode *funcDef;
         typeClass *varType;
@@ -128,6 +140,7 @@ class stmtNode : public Node {
 
 class fdefNode : public Node {
     public:
+        TRACK_NEW(KIND_FDEF)
         fdefNode(headerNode *h, stmtNode *b);
         headerNode *head;
         stmtNode *body;
@@ -135,4 +148,14 @@ class fdefNode : public Node {
         void semanticCheck(SymbolTable &sym);
 };
 
+void freeType(typeClass *t);
+void freeHeader(headerNode *h);
+void freeStmts(stmtNode *stmt, bool headers = false);
+void freeProgram(fdefNode *root);
+
+/* Streaming check (--stream): the parser checks each function as soon as it is complete. */
+void streamEnterFunction(headerNode *head, SymbolTable &sym);
+void streamLocalDef(stmtNode *def, SymbolTable &sym);
+void streamLeaveFunction(fdefNode *def, SymbolTable &sym);
+
 #endif
\ No newline at end of file
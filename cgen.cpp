@@ -0,0 +1,905 @@
+#include "cgen.hpp"
+#include "loop.hpp"
+#include <sstream>
+#include <vector>
+#include <string>
+#include <set>
+#include <map>
+#include <memory>
+#include <algorithm>
+
+/*
+ * Translation happens in two passes. The first resolves every variable the way
+ * the semantic check does (parameters, then local definitions in source order,
+ * one scope per if arm and loop body) and takes each call's function from the
+ * check. A variable used by a nested function is "captured" and lives in
+ * its owner's frame struct; every other variable stays a plain C local so the C
+ * compiler can keep it in a register. Only functions that reach such variables,
+ * directly or through their calls and nested functions, take an `up` pointer,
+ * and only functions with such a nested function keep a frame. The second pass prints the C code; in
+ * front of a loop it declares the temporaries of the loop's plan (loop.hpp), and
+ * inside the loop the expressions they replace print as the temporaries. A
+ * loop planned as a vector kernel first calls a function that runs all its
+ * iterations, and the loop itself only runs when the arrays may overlap.
+ */
+
+struct CFunc;
+
+struct CVar {
+    std::string cname;
+    typeClass *type;
+    bool param;
+    bool ref;
+    bool captured = false;
+    CFunc *owner;
+};
+
+struct CFunc {
+    headerNode *head;
+    fdefNode *def = nullptr;
+    std::string cname;
+    CFunc *parent;
+    int depth = 0;         // nesting: 0 for top-level functions
+    int reach = 0;         // depth of the outermost frame the function uses; depth if none
+    bool frame = false;    // a nested function uses the function's frame
+    bool external = false; // module export or import: linked by name across C files
+    std::vector<CVar*> params;
+    std::vector<CVar*> locals;
+    std::vector<CFunc*> children;
+    std::set<std::string> used; // C names taken inside the function
+    std::vector<CFunc*> callees;
+
+    bool needsUp() const { return reach < depth; }
+};
+
+/* A loop run by a vector kernel, with the variables the kernel takes. */
+struct CKernel {
+    int id = 0;
+    const LoopKernel *loop = nullptr;
+    const CVar *iv = nullptr;
+    const CVar *acc = nullptr;   // sum
+    const CVar *dst = nullptr;   // fill, copy, map
+    std::vector<const CVar*> sources; // arrays read
+    std::vector<const CVar*> scalars; // invariants
+};
+
+static const std::set<std::string> reserved = {
+    "auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum",
+    "extern", "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return",
+    "short", "signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void",
+    "volatile", "while", "_Bool", "_Complex", "_Imaginary", "byte", "main", "fr", "up"
+};
+
+static bool clashes(const std::string &name) {
+    return reserved.count(name) || name.compare(0, 2, "f_") == 0 || name.compare(0, 5, "dana_") == 0 ||
+           name.compare(0, 6, "frame_") == 0 || name.compare(0, 2, "m_") == 0 || name.compare(0, 4, "brk_") == 0 || name.compare(0, 5, "cont_") == 0 ||
+           name.compare(0, 4, "inv_") == 0 || name.compare(0, 4, "idx_") == 0 || name.compare(0, 4, "row_") == 0;
+}
+
+static std::string uniqueName(std::string name, std::set<std::string> &used, bool function = false) {
+    if (function) name = "f_" + name;
+    else if (clashes(name)) name = "v_" + name;
+    std::string candidate = name;
+    for (int n = 2; used.count(candidate); n++) candidate = name + "_" + std::to_string(n);
+    used.insert(candidate);
+    return candidate;
+}
+
+/* Splits an array type into its element type and its sizes in source order (0 = open). */
+static typeClass *arrayDims(typeClass *t, std::vector<int> &dims) {
+    while (t->isArray()) {
+        arrayType *a = static_cast<arrayType*>(t);
+        dims.insert(dims.begin(), a->getSize() ? a->getSize()->value : 0);
+        t = a->getBaseType();
+    }
+    return t;
+}
+
+static typeClass *stripRef(typeClass *t) {
+    return t->isRef() ? static_cast<refType*>(t)->getBaseType() : t;
+}
+
+static std::string scalarType(typeClass *t) {
+    switch (t->getType()) {
+        case TYPE_INT: return "int";
+        case TYPE_VOID: return "void";
+        default: return "byte";
+    }
+}
+
+/* Declarator of a variable: `int a[3][4]`. */
+static std::string varDecl(typeClass *t, const std::string &name) {
+    std::vector<int> dims;
+    std::string out = scalarType(arrayDims(t, dims)) + " " + name;
+    for (int d : dims) out += "[" + std::to_string(d) + "]";
+    return out;
+}
+
+/* Declarator of a parameter: arrays decay to a pointer to their first element, refs to a pointer. */
+static std::string paramDecl(const CVar *v) {
+    typeClass *t = stripRef(v->type);
+    if (v->ref) return scalarType(t) + " *" + v->cname;
+    std::vector<int> dims;
+    std::string base = scalarType(arrayDims(t, dims));
+    if (dims.empty()) return base + " " + v->cname;
+    if (dims.size() == 1) return base + " *" + v->cname;
+    std::string out = base + " (*" + v->cname + ")";
+    for (size_t i = 1; i < dims.size(); i++) out += "[" + std::to_string(dims[i]) + "]";
+    return out;
+}
+
+static std::string charLiteral(int value) {
+    value &= 0xff;
+    switch (value) {
+        case '\n': return "'\\n'";
+        case '\t': return "'\\t'";
+        case '\r': return "'\\r'";
+        case '\0': return "'\\0'";
+        case '\'': return "'\\''";
+        case '\\': return "'\\\\'";
+    }
+    if (value >= 32 && value < 127) return std::string("'") + (char)value + "'";
+    return std::to_string(value);
+}
+
+/* Dana string literal (quotes included) to C; \xHH and \0 become octal so following digits stay literal. */
+static std::string stringLiteral(const std::string &text) {
+    std::string out = "\"";
+    for (size_t i = 1; i + 1 < text.size(); i++) {
+        if (text[i] != '\\') {
+            out += text[i];
+            continue;
+        }
+        char esc = text[++i];
+        char buf[8];
+        if (esc == 'x' && i + 2 < text.size()) {
+            snprintf(buf, sizeof buf, "\\%03o", (unsigned)std::stoi(text.substr(i + 1, 2), nullptr, 16));
+            out += buf;
+            i += 2;
+        }
+        else if (esc == '0') out += "\\000";
+        else {
+            out += '\\';
+            out += esc;
+        }
+    }
+    return out + "\"";
+}
+
+/* Drops one pair of parentheses enclosing the whole expression, for statement and argument positions. */
+static std::string bare(const std::string &text) {
+    if (text.size() < 2 || text.front() != '(' || text.back() != ')') return text;
+    int depth = 0;
+    char quote = 0;
+    for (size_t i = 0; i + 1 < text.size(); i++) {
+        char c = text[i];
+        if (quote) {
+            if (c == '\\') i++;
+            else if (c == quote) quote = 0;
+        }
+        else if (c == '"' || c == '\'') quote = c;
+        else if (c == '(') depth++;
+        else if (c == ')' && --depth == 0) return text;
+    }
+    return text.substr(1, text.size() - 2);
+}
+
+class CEmitter {
+public:
+    CEmitter(std::ostream &o, const CEmitOptions &opts) : out(o), opts(opts) {}
+    void run(fdefNode *root);
+
+private:
+    // resolution
+    CFunc *declareFunc(headerNode *h, CFunc *parent);
+    void resolveFunc(CFunc *fn, fdefNode *def);
+    void resolveStmts(CFunc *fn, stmtNode *stmt);
+    void resolveLval(CFunc *fn, lvalNode *l);
+    void resolveExpr(CFunc *fn, exprNode *e);
+    CVar *lookup(const std::string &name) const;
+    CFunc *importedFunc(const headerNode *target);
+    void resolveCalls();
+    void linkFrames();
+    void chooseInlined();
+
+    // emission
+    std::string frameName(const CFunc *fn) const { return "frame_" + fn->cname.substr(2); }
+    std::string prototype(const CFunc *fn) const;
+    std::string upPath(const CFunc *from, const CFunc *to) const;
+    std::string varRef(const CVar *v, const CFunc *cur) const;
+    std::string lval(lvalNode *l, const CFunc *cur) const;
+    std::string rowPrefix(lvalNode *l, const CFunc *cur) const;
+    std::string temporary(const void *node) const;
+    std::string call(fcallNode *c, const CFunc *cur) const;
+    std::string expr(exprNode *e, const CFunc *cur) const;
+    std::string cond(exprNode *e, const CFunc *cur, int hint) const;
+    bool isByte(exprNode *e) const;
+    typeClass *lvalType(lvalNode *l) const;
+    std::string counter(const Node *n) const;
+    void emitFrame(const CFunc *fn);
+    void emitFunc(const CFunc *fn);
+    void emitStmts(stmtNode *stmt, const CFunc *cur, int depth);
+    void emitLoopPlan(const LoopPlan &plan, int id, const CFunc *cur, int depth);
+    void collectKernels(stmtNode *stmt);
+    void kernelVars(exprNode *e, CKernel &k);
+    void emitKernel(const CKernel &k);
+    void emitKernelCall(const CKernel &k, const CFunc *cur, int depth);
+    void emitProfileTables();
+    void line(int depth, const std::string &text) { out << std::string(4 * depth, ' ') << text << "\n"; }
+
+    std::ostream &out;
+    const CEmitOptions &opts;
+
+    std::vector<std::unique_ptr<CVar>> varStore;
+    std::vector<std::unique_ptr<CFunc>> funcStore;
+    std::vector<CFunc*> funcs; // definition order, root first
+    std::vector<CFunc*> imported;
+    std::set<std::string> funcNames;
+    std::vector<std::map<std::string, CVar*>> scopes; // variables; functions never hide them
+    std::map<std::string, CFunc*> funcByName;         // first function of each name, like the check's scope 0
+    std::vector<stmtNode*> loops;
+
+    std::map<const lvalNode*, CVar*> varOf;
+    std::vector<std::pair<CFunc*, fcallNode*>> calls; // with the calling function, in source order
+    std::map<const headerNode*, CFunc*> funcOfHead;  // declaration and definition headers
+    std::map<const fcallNode*, CFunc*> funcOf;       // missing: builtin
+    std::set<const CFunc*> inlined;                  // hot, small and not recursive, under -fprofile-use
+    std::map<const stmtNode*, std::vector<CVar*>> declared;
+    std::map<const stmtNode*, const stmtNode*> jumpTarget;
+
+    LoopPlans plans;
+    std::vector<std::pair<const LoopPlan*, int>> openPlans; // plans of the loops being printed, with their ids
+    std::vector<CKernel> kernels;                           // in source order
+    std::map<const stmtNode*, size_t> kernelOf;
+    std::map<const CVar*, std::string> kernelNames;         // non-empty while printing a kernel
+
+    std::vector<const stmtNode*> openLoops;
+    std::map<const stmtNode*, int> loopIds;
+    std::set<const stmtNode*> breakLabels, continueLabels;
+};
+
+CFunc *CEmitter::declareFunc(headerNode *h, CFunc *parent) {
+    funcStore.emplace_back(new CFunc());
+    CFunc *fn = funcStore.back().get();
+    fn->head = h;
+    fn->parent = parent;
+    fn->depth = fn->reach = parent ? parent->depth + 1 : 0;
+    funcOfHead[h] = fn;
+    if (!parent && !opts.module.empty()) {
+        fn->cname = "m_" + opts.module + "_" + h->iden->name;
+        fn->external = true;
+    }
+    else fn->cname = uniqueName(h->iden->name, funcNames, true);
+    if (parent) parent->children.push_back(fn);
+    return fn;
+}
+
+CVar *CEmitter::lookup(const std::string &name) const {
+    for (auto s = scopes.rbegin(); s != scopes.rend(); ++s) {
+        auto it = s->find(name);
+        if (it != s->end()) return it->second;
+    }
+    return nullptr;
+}
+
+/* A function loaded from an interface gets its CFunc the first time a call goes to it; null for builtins. */
+CFunc *CEmitter::importedFunc(const headerNode *target) {
+    if (!opts.imports) return nullptr;
+    for (const Interface &iface : *opts.imports)
+        for (headerNode *h : iface.exports) {
+            if (h != target) continue;
+            funcStore.emplace_back(new CFunc());
+            CFunc *fn = funcStore.back().get();
+            fn->head = h;
+            fn->parent = nullptr;
+            fn->external = true;
+            fn->cname = "m_" + iface.module + "_" + h->iden->name;
+            funcOfHead[h] = fn;
+            for (paramNode *p = h->params; p; p = p->tail)
+                for (auto &pname : *p->names) {
+                    varStore.emplace_back(new CVar{uniqueName(pname, fn->used), p->types, true, p->ref, false, fn});
+                    fn->params.push_back(varStore.back().get());
+                }
+            imported.push_back(fn);
+            return fn;
+        }
+    return nullptr;
+}
+
+void CEmitter::resolveFunc(CFunc *fn, fdefNode *def) {
+    fn->def = def;
+    funcs.push_back(fn);
+    scopes.emplace_back();
+    for (paramNode *p = fn->head->params; p; p = p->tail)
+        for (auto &name : *p->names) {
+            varStore.emplace_back(new CVar{uniqueName(name, fn->used), p->types, true, p->ref, false, fn});
+            fn->params.push_back(varStore.back().get());
+            scopes.back()[name] = varStore.back().get();
+        }
+    std::vector<stmtNode*> outer;
+    outer.swap(loops); // break and continue never leave a function
+    resolveStmts(fn, def->body);
+    loops.swap(outer);
+    scopes.pop_back();
+}
+
+void CEmitter::resolveStmts(CFunc *fn, stmtNode *stmt) {
+    for (; stmt; stmt = stmt->stmtTail) {
+        const std::string &kind = stmt->stmtType;
+        if (kind == "vardecl") {
+            for (auto &name : *stmt->varNames) {
+                varStore.emplace_back(new CVar{uniqueName(name, fn->used), stmt->varType, false, false, false, fn});
+                fn->locals.push_back(varStore.back().get());
+                declared[stmt].push_back(varStore.back().get());
+                scopes.back()[name] = varStore.back().get();
+            }
+        }
+        else if (kind == "decl" || kind == "def") {
+            const std::string &name = stmt->funcDef->head->iden->name;
+            auto it = funcByName.find(name);
+            CFunc *f = it != funcByName.end() && !it->second->def && it->second->parent == fn ? it->second : nullptr;
+            if (!f) f = declareFunc(stmt->funcDef->head, fn);
+            funcOfHead[stmt->funcDef->head] = f;
+            funcByName.emplace(name, f);
+            if (kind == "def") resolveFunc(f, stmt->funcDef);
+        }
+        else if (kind == "asgn") {
+            resolveLval(fn, stmt->lval);
+            resolveExpr(fn, stmt->exp);
+        }
+        else if (kind == "pc" || kind == "return") resolveExpr(fn, stmt->exp);
+        else if (kind == "if") {
+            for (ifNode *n = stmt->ifnode; n; n = n->tail) {
+                resolveExpr(fn, n->cond);
+                scopes.emplace_back();
+                resolveStmts(fn, n->stmt);
+                scopes.pop_back();
+            }
+        }
+        else if (kind == "loop") {
+            loops.push_back(stmt);
+            scopes.emplace_back();
+            resolveStmts(fn, stmt->stmtBody);
+            scopes.pop_back();
+            loops.pop_back();
+        }
+        else if (kind == "break" || kind == "continue") {
+            for (auto l = loops.rbegin(); l != loops.rend(); ++l)
+                if (!stmt->tag || ((*l)->tag && (*l)->tag->name == stmt->tag->name)) {
+                    jumpTarget[stmt] = *l;
+                    break;
+                }
+        }
+    }
+}
+
+void CEmitter::resolveLval(CFunc *fn, lvalNode *l) {
+    if (!l->isString) {
+        CVar *v = lookup(l->ident->name);
+        if (v && v->owner != fn) {
+            v->captured = true;
+            fn->reach = std::min(fn->reach, v->owner->depth);
+        }
+        varOf[l] = v;
+    }
+    for (exprNode *idx : *l->ind) resolveExpr(fn, idx);
+}
+
+void CEmitter::resolveExpr(CFunc *fn, exprNode *e) {
+    if (!e) return;
+    if (e->op == 'i') resolveLval(fn, e->lval);
+    else if (e->op == 'f') {
+        calls.emplace_back(fn, e->func);
+        if (e->func->args)
+            for (exprNode *arg : *e->func->args) resolveExpr(fn, arg);
+    }
+    resolveExpr(fn, e->leftExpr);
+    resolveExpr(fn, e->rightExpr);
+}
+
+/*
+ * Calls go to the function the semantic check resolved them to, which may be
+ * declared after the call in source order, so they are bound once every
+ * function is.
+ */
+void CEmitter::resolveCalls() {
+    for (auto &c : calls) {
+        auto it = funcOfHead.find(c.second->target);
+        CFunc *f = it != funcOfHead.end() ? it->second : importedFunc(c.second->target);
+        if (!f) continue;
+        funcOf[c.second] = f;
+        c.first->callees.push_back(f);
+    }
+}
+
+/*
+ * A function reaches the frames its variables come from, those its callees need
+ * passed (the callee's parent's), and those its nested functions reach through
+ * its own frame. Recursion makes this a fixed point. The check lets any function
+ * call any nested one, but one that needs its parent's frame can only be called
+ * where that frame exists: inside the parent.
+ */
+void CEmitter::linkFrames() {
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (CFunc *fn : funcs) {
+            int reach = fn->reach;
+            for (const CFunc *callee : fn->callees)
+                if (callee->needsUp() && callee->parent != fn) reach = std::min(reach, callee->parent->depth);
+            for (const CFunc *child : fn->children) reach = std::min(reach, child->reach);
+            changed = changed || reach < fn->reach;
+            fn->reach = reach;
+        }
+    }
+    for (CFunc *fn : funcs)
+        if (fn->needsUp()) fn->parent->frame = true;
+    for (auto &c : calls) {
+        auto it = funcOf.find(c.second);
+        if (it == funcOf.end() || !it->second->needsUp()) continue;
+        const CFunc *from = c.first;
+        while (from && from != it->second->parent) from = from->parent;
+        if (!from)
+            throw SemanticError("'" + c.second->iden->name + "' uses variables of '" + it->second->parent->head->iden->name +
+                                "' and cannot be called outside it", c.second->lineno);
+    }
+}
+
+/* Path from a function's `up` pointer to the frame of one of its ancestors. */
+/* Statements a function runs itself, nested blocks included and nested functions not. */
+static int bodySize(stmtNode *stmt) {
+    int n = 0;
+    for (; stmt; stmt = stmt->stmtTail) {
+        const std::string &kind = stmt->stmtType;
+        if (kind == "def" || kind == "decl" || kind == "vardecl") continue;
+        n++;
+        if (kind == "loop") n += bodySize(stmt->stmtBody);
+        else if (kind == "if")
+            for (ifNode *arm = stmt->ifnode; arm; arm = arm->tail) n += bodySize(arm->stmt);
+    }
+    return n;
+}
+
+/*
+ * Under -fprofile-use a hot function is inlined into its callers when it is
+ * small and cannot reach itself through its calls. The program's entry and
+ * module exports keep their bodies.
+ */
+void CEmitter::chooseInlined() {
+    static const int inlineLimit = 12; // statements
+    for (const CFunc *fn : funcs) {
+        if (!fn->parent || fn->external || !opts.profile->isHot(fn->def) || bodySize(fn->def->body) > inlineLimit) continue;
+        std::set<const CFunc*> seen;
+        std::vector<const CFunc*> work(fn->callees.begin(), fn->callees.end());
+        bool recursive = false;
+        while (!work.empty() && !recursive) {
+            const CFunc *f = work.back();
+            work.pop_back();
+            recursive = f == fn;
+            if (seen.insert(f).second) work.insert(work.end(), f->callees.begin(), f->callees.end());
+        }
+        if (!recursive) inlined.insert(fn);
+    }
+}
+
+std::string CEmitter::upPath(const CFunc *from, const CFunc *to) const {
+    std::string path = "up";
+    for (const CFunc *f = from->parent; f && f != to; f = f->parent) path += "->up";
+    return path;
+}
+
+std::string CEmitter::varRef(const CVar *v, const CFunc *cur) const {
+    if (!kernelNames.empty()) return kernelNames.at(v);
+    std::string ref;
+    if (v->owner == cur) ref = v->captured ? "fr." + v->cname : v->cname;
+    else ref = upPath(cur, v->owner) + "->" + v->cname;
+    return v->ref ? "(*" + ref + ")" : ref;
+}
+
+typeClass *CEmitter::lvalType(lvalNode *l) const {
+    static basicType byteType(TYPE_CHAR);
+    auto it = varOf.find(l);
+    if (l->isString || it == varOf.end() || !it->second) return &byteType;
+    typeClass *t = stripRef(it->second->type);
+    for (size_t i = 0; i < l->ind->size() && t->isArray(); i++) t = static_cast<arrayType*>(t)->getBaseType();
+    return t;
+}
+
+/* Whether an arithmetic expression is computed in byte, so its result must wrap at 256. */
+bool CEmitter::isByte(exprNode *e) const {
+    switch (e->op) {
+        case 'c': return false;
+        case 'x': case 'b': return true;
+        case 'i': return lvalType(e->lval)->getType() != TYPE_INT;
+        case 'f': return e->func->target && e->func->target->headType->getType() != TYPE_INT;
+        default: return e->rightExpr ? isByte(e->rightExpr) : false;
+    }
+}
+
+/* The temporary an open loop keeps for an expression or a row address, innermost loop first; empty if none. */
+std::string CEmitter::temporary(const void *node) const {
+    for (auto p = openPlans.rbegin(); p != openPlans.rend(); ++p) {
+        const LoopPlan &plan = *p->first;
+        std::string id = std::to_string(p->second) + "_";
+        auto inv = plan.invariantOf.find(static_cast<const exprNode*>(node));
+        if (inv != plan.invariantOf.end()) return "inv_" + id + std::to_string(inv->second);
+        auto red = plan.reductionOf.find(static_cast<const exprNode*>(node));
+        if (red != plan.reductionOf.end()) return "idx_" + id + std::to_string(red->second);
+        auto row = plan.rowOf.find(static_cast<const lvalNode*>(node));
+        if (row != plan.rowOf.end()) return "row_" + id + std::to_string(row->second);
+    }
+    return "";
+}
+
+/* a[i]..[j] of a[i]..[j][k]. */
+std::string CEmitter::rowPrefix(lvalNode *l, const CFunc *cur) const {
+    std::string ref = varRef(varOf.at(l), cur);
+    for (size_t i = 0; i + 1 < l->ind->size(); i++) ref += "[" + bare(expr((*l->ind)[i], cur)) + "]";
+    return ref;
+}
+
+std::string CEmitter::lval(lvalNode *l, const CFunc *cur) const {
+    std::string ref = temporary(l);
+    if (!ref.empty()) return ref + "[" + bare(expr(l->ind->back(), cur)) + "]";
+    if (l->isString) ref = "((byte *)" + stringLiteral(l->ident->name) + ")";
+    else ref = varRef(varOf.at(l), cur);
+    for (exprNode *idx : *l->ind) ref += "[" + bare(expr(idx, cur)) + "]";
+    return ref;
+}
+
+std::string CEmitter::call(fcallNode *c, const CFunc *cur) const {
+    std::vector<std::string> args;
+    std::vector<const CVar*> params;
+    auto it = funcOf.find(c);
+    std::string name = "dana_" + c->iden->name;
+    if (it != funcOf.end()) {
+        const CFunc *callee = it->second;
+        name = callee->cname;
+        if (callee->needsUp()) args.push_back(callee->parent == cur ? "&fr" : upPath(cur, callee->parent));
+        params.assign(callee->params.begin(), callee->params.end());
+    }
+    if (c->args)
+        for (size_t i = 0; i < c->args->size(); i++) {
+            exprNode *arg = (*c->args)[i];
+            if (i < params.size() && params[i]->ref) args.push_back("&" + lval(arg->lval, cur));
+            else args.push_back(bare(expr(arg, cur)));
+        }
+    std::string text = name + "(";
+    for (size_t i = 0; i < args.size(); i++) text += (i ? ", " : "") + args[i];
+    return text + ")";
+}
+
+std::string CEmitter::expr(exprNode *e, const CFunc *cur) const {
+    static const std::map<char, std::string> binary = {
+        {'+', "+"}, {'-', "-"}, {'*', "*"}, {'/', "/"}, {'%', "%"}, {'&', "&"}, {'|', "|"},
+        {'<', "<"}, {'>', ">"}, {'=', "=="}, {'d', "!="}, {'g', ">="}, {'l', "<="}, {'a', "&&"}, {'o', "||"}
+    };
+    std::string temp = temporary(e);
+    if (!temp.empty()) return temp;
+    switch (e->op) {
+        case 'c': return std::to_string(e->constant->value);
+        case 'x': return charLiteral(e->constant->value);
+        case 'b': return e->tfFlag ? "1" : "0";
+        case 'i': return lval(e->lval, cur);
+        case 'f': return call(e->func, cur);
+        case '!': case 'n': return "(!" + expr(e->rightExpr, cur) + ")";
+    }
+    std::string text;
+    if (!e->leftExpr) {
+        if (e->op == '+') return expr(e->rightExpr, cur);
+        text = "(-" + expr(e->rightExpr, cur) + ")";
+    }
+    else text = "(" + expr(e->leftExpr, cur) + " " + binary.at(e->op) + " " + expr(e->rightExpr, cur) + ")";
+    if (std::string("+-*/%").find(e->op) != std::string::npos && isByte(e)) text = "((byte)" + text + ")";
+    return text;
+}
+
+/* A condition, wrapped in DANA_LIKELY/DANA_UNLIKELY when the profile says so (hint > 0 / < 0). */
+std::string CEmitter::cond(exprNode *e, const CFunc *cur, int hint) const {
+    std::string text = bare(expr(e, cur));
+    if (hint > 0) return "DANA_LIKELY(" + text + ")";
+    if (hint < 0) return "DANA_UNLIKELY(" + text + ")";
+    return text;
+}
+
+std::string CEmitter::counter(const Node *n) const {
+    if (!opts.instrument || !opts.profile) return "";
+    int id = opts.profile->siteOf(n);
+    return id < 0 ? "" : "dana_counts[" + std::to_string(id) + "]++";
+}
+
+std::string CEmitter::prototype(const CFunc *fn) const {
+    std::string text = fn->external ? "" : "static ";
+    if (opts.hints && opts.profile && fn->def) {
+        if (inlined.count(fn)) text += "DANA_INLINE ";
+        if (opts.profile->isHot(fn->def)) text += "DANA_HOT ";
+        else if (opts.profile->isCold(fn->def)) text += "DANA_COLD ";
+    }
+    text += scalarType(fn->head->headType) + " " + fn->cname + "(";
+    std::vector<std::string> params;
+    if (fn->needsUp()) params.push_back("struct " + frameName(fn->parent) + " *up");
+    for (const CVar *p : fn->params) params.push_back(paramDecl(p));
+    if (params.empty()) params.push_back("void");
+    for (size_t i = 0; i < params.size(); i++) text += (i ? ", " : "") + params[i];
+    return text + ")";
+}
+
+void CEmitter::emitFrame(const CFunc *fn) {
+    out << "struct " << frameName(fn) << " {\n";
+    if (fn->needsUp()) line(1, "struct " + frameName(fn->parent) + " *up;");
+    for (const CVar *p : fn->params)
+        if (p->captured) line(1, paramDecl(p) + ";");
+    for (const CVar *v : fn->locals)
+        if (v->captured) line(1, varDecl(v->type, v->cname) + ";");
+    out << "};\n\n";
+}
+
+void CEmitter::emitFunc(const CFunc *fn) {
+    out << prototype(fn) << " {\n";
+    if (fn->frame) {
+        line(1, "struct " + frameName(fn) + " fr;");
+        if (fn->needsUp()) line(1, "fr.up = up;");
+        for (const CVar *p : fn->params)
+            if (p->captured) line(1, "fr." + p->cname + " = " + p->cname + ";");
+    }
+    std::string entry = counter(fn->def);
+    if (!entry.empty()) line(1, entry + ";");
+    emitStmts(fn->def->body, fn, 1);
+    out << "}\n\n";
+}
+
+void CEmitter::emitStmts(stmtNode *stmt, const CFunc *cur, int depth) {
+    for (; stmt; stmt = stmt->stmtTail) {
+        const std::string &kind = stmt->stmtType;
+        if (kind == "vardecl") {
+            for (const CVar *v : declared[stmt])
+                if (!v->captured) line(depth, varDecl(v->type, v->cname) + ";");
+        }
+        else if (kind == "asgn") {
+            line(depth, lval(stmt->lval, cur) + " = " + bare(expr(stmt->exp, cur)) + ";");
+            for (auto &p : openPlans) // running indices follow their induction variable
+                for (size_t k = 0; k < p.first->reductions.size(); k++) {
+                    const LoopReduction &r = p.first->reductions[k];
+                    if (r.update != stmt) continue;
+                    bool unit = r.step->op == 'c' && r.step->constant->value == 1;
+                    line(depth, "idx_" + std::to_string(p.second) + "_" + std::to_string(k) + (r.down ? " -= " : " += ") +
+                                (unit ? "" : expr(r.step, cur) + " * ") + expr(r.factor, cur) + ";");
+                }
+        }
+        else if (kind == "pc") line(depth, call(stmt->exp->func, cur) + ";");
+        else if (kind == "exit") line(depth, "return;");
+        else if (kind == "return") line(depth, "return " + bare(expr(stmt->exp, cur)) + ";");
+        else if (kind == "if") {
+            std::string chain = counter(stmt);
+            if (!chain.empty()) line(depth, chain + ";");
+            int likely = opts.hints && opts.profile ? opts.profile->likelyArm(stmt->ifnode) : -1;
+            int arm = 0;
+            for (ifNode *n = stmt->ifnode; n; n = n->tail, arm++) {
+                int hint = likely < 0 ? 0 : arm == likely ? 1 : arm < likely ? -1 : 0;
+                if (!n->cond) line(depth, "} else {");
+                else line(depth, std::string(arm ? "} else if (" : "if (") + cond(n->cond, cur, hint) + ") {");
+                std::string taken = counter(n);
+                if (!taken.empty()) line(depth + 1, taken + ";");
+                emitStmts(n->stmt, cur, depth + 1);
+            }
+            line(depth, "}");
+        }
+        else if (kind == "loop") {
+            int id = (int)loopIds.size();
+            loopIds[stmt] = id;
+            auto plan = plans.find(stmt);
+            if (plan != plans.end()) {
+                emitLoopPlan(plan->second, id, cur, depth);
+                openPlans.emplace_back(&plan->second, id);
+            }
+            auto kernel = kernelOf.find(stmt);
+            if (kernel != kernelOf.end()) emitKernelCall(kernels[kernel->second], cur, depth);
+            line(depth, "for (;;" + (counter(stmt).empty() ? "" : " " + counter(stmt)) + ") {");
+            openLoops.push_back(stmt);
+            emitStmts(stmt->stmtBody, cur, depth + 1);
+            if (plan != plans.end()) openPlans.pop_back();
+            openLoops.pop_back();
+            if (continueLabels.count(stmt)) line(depth, "cont_" + std::to_string(id) + ": ;");
+            line(depth, "}");
+            if (breakLabels.count(stmt)) line(depth, "brk_" + std::to_string(id) + ": ;");
+        }
+        else if (kind == "break" || kind == "continue") {
+            auto it = jumpTarget.find(stmt);
+            if (it == jumpTarget.end()) continue;
+            bool brk = kind == "break";
+            if (!openLoops.empty() && it->second == openLoops.back()) line(depth, kind + ";");
+            else {
+                (brk ? breakLabels : continueLabels).insert(it->second);
+                line(depth, std::string("goto ") + (brk ? "brk_" : "cont_") + std::to_string(loopIds.at(it->second)) + ";");
+            }
+        }
+    }
+}
+
+/* Declares a loop's temporaries, with the plans of the enclosing loops open. Row addresses may use the loop's own invariants. */
+void CEmitter::emitLoopPlan(const LoopPlan &plan, int id, const CFunc *cur, int depth) {
+    std::string suffix = std::to_string(id) + "_";
+    for (size_t k = 0; k < plan.invariants.size(); k++) {
+        exprNode *e = plan.invariants[k];
+        line(depth, std::string(isByte(e) ? "byte" : "int") + " inv_" + suffix + std::to_string(k) + " = " + bare(expr(e, cur)) + ";");
+    }
+    for (size_t k = 0; k < plan.reductions.size(); k++)
+        line(depth, "int idx_" + suffix + std::to_string(k) + " = " + bare(expr(plan.reductions[k].product, cur)) + ";");
+    openPlans.emplace_back(&plan, id);
+    for (size_t k = 0; k < plan.rows.size(); k++) {
+        lvalNode *l = plan.rows[k];
+        line(depth, scalarType(lvalType(l)) + " *row_" + suffix + std::to_string(k) + " = " + rowPrefix(l, cur) + ";");
+    }
+    openPlans.pop_back();
+}
+
+/* Loops planned as vector kernels whose variables have distinct C names, as the kernel's parameters need. */
+void CEmitter::collectKernels(stmtNode *stmt) {
+    for (; stmt; stmt = stmt->stmtTail) {
+        if (stmt->stmtType == "if")
+            for (ifNode *n = stmt->ifnode; n; n = n->tail) collectKernels(n->stmt);
+        if (stmt->stmtType != "loop") continue;
+        collectKernels(stmt->stmtBody);
+        auto plan = plans.find(stmt);
+        if (plan == plans.end() || !plan->second.vector) continue;
+        const LoopKernel &loop = plan->second.kernel;
+        CKernel k;
+        k.id = (int)kernels.size();
+        k.loop = &loop;
+        k.iv = varOf.at(loop.update->lval);
+        if (loop.idiom == "sum") k.acc = varOf.at(loop.work->lval);
+        else k.dst = varOf.at(loop.work->lval);
+        kernelVars(loop.work->exp, k);
+        std::set<std::string> names{k.iv->cname, k.acc ? k.acc->cname : k.dst->cname};
+        bool distinct = true;
+        for (const CVar *v : k.sources) distinct = distinct && (v == k.dst || names.insert(v->cname).second);
+        for (const CVar *v : k.scalars) distinct = distinct && names.insert(v->cname).second;
+        if (!distinct) continue;
+        kernelOf[stmt] = kernels.size();
+        kernels.push_back(k);
+    }
+}
+
+void CEmitter::kernelVars(exprNode *e, CKernel &k) {
+    if (!e) return;
+    if (e->op == 'i') {
+        const CVar *v = varOf.at(e->lval);
+        std::vector<const CVar*> &list = e->lval->ind->empty() ? k.scalars : k.sources;
+        if (v != k.acc && v != k.dst && std::find(list.begin(), list.end(), v) == list.end()) list.push_back(v);
+        return;
+    }
+    kernelVars(e->leftExpr, k);
+    kernelVars(e->rightExpr, k);
+}
+
+/*
+ * Blocks of one vector's worth of iterations, which the C compiler vectorizes
+ * without a remainder loop of its own, then the rest one at a time. A sum keeps
+ * one partial sum per lane.
+ */
+void CEmitter::emitKernel(const CKernel &k) {
+    const LoopKernel &loop = *k.loop;
+    std::string elem = loop.elem == TYPE_INT ? "int" : "byte", lanes = loop.elem == TYPE_INT ? "8" : "32";
+    std::string iv = k.iv->cname;
+    std::vector<std::string> params{"int dana_lo", "int dana_hi"};
+    if (k.acc) params.push_back(scalarType(stripRef(k.acc->type)) + " " + k.acc->cname);
+    else params.push_back(elem + " *restrict " + k.dst->cname);
+    for (const CVar *v : k.sources)
+        if (v != k.dst) params.push_back("const " + elem + " *restrict " + v->cname);
+    for (const CVar *v : k.scalars) params.push_back(scalarType(stripRef(v->type)) + " " + v->cname);
+    std::string text = "DANA_KERNEL " + (k.acc ? scalarType(stripRef(k.acc->type)) : std::string("void")) +
+                       " dana_kernel_" + std::to_string(k.id) + "(";
+    for (size_t i = 0; i < params.size(); i++) text += (i ? ", " : "") + params[i];
+    out << text << ") {\n";
+
+    kernelNames[k.iv] = iv;
+    kernelNames[k.acc ? k.acc : k.dst] = k.acc ? k.acc->cname : k.dst->cname;
+    for (const CVar *v : k.sources) kernelNames[v] = v->cname;
+    for (const CVar *v : k.scalars) kernelNames[v] = v->cname;
+    std::string work = lval(loop.work->lval, nullptr) + " = " + bare(expr(loop.work->exp, nullptr)) + ";";
+    if (k.acc) {
+        line(1, scalarType(stripRef(k.acc->type)) + " dana_part[" + lanes + "] = {0};");
+        kernelNames[k.acc] = "dana_part[" + iv + " - dana_blk]";
+    }
+    std::string block = lval(loop.work->lval, nullptr) + " = " + bare(expr(loop.work->exp, nullptr)) + ";";
+    kernelNames.clear();
+
+    line(1, "int dana_blk = dana_lo, " + iv + ";");
+    line(1, "for (; dana_hi - dana_blk >= " + lanes + "; dana_blk += " + lanes + ") {");
+    line(2, "DANA_IVDEP");
+    line(2, "for (" + iv + " = dana_blk; " + iv + " < dana_blk + " + lanes + "; " + iv + "++) " + block);
+    line(1, "}");
+    if (k.acc)
+        line(1, "for (" + iv + " = 0; " + iv + " < " + lanes + "; " + iv + "++) " + k.acc->cname + " = " + k.acc->cname + " + dana_part[" + iv + "];");
+    line(1, "for (" + iv + " = dana_blk; " + iv + " < dana_hi; " + iv + "++) " + work);
+    if (k.acc) line(1, "return " + k.acc->cname + ";");
+    out << "}\n\n";
+}
+
+/* Runs the iterations left in the kernel, leaving iv where the loop would; the loop then exits at once. */
+void CEmitter::emitKernelCall(const CKernel &k, const CFunc *cur, int depth) {
+    const LoopKernel &loop = *k.loop;
+    std::string iv = varRef(k.iv, cur);
+    std::string hi = loop.inclusive ? expr(loop.bound, cur) + " + 1" : bare(expr(loop.bound, cur));
+    std::string test = iv + (loop.inclusive ? " <= " : " < ") + expr(loop.bound, cur);
+    if (loop.aliasCheck) {
+        std::vector<const CVar*> arrays(k.sources);
+        if (k.dst && std::find(arrays.begin(), arrays.end(), k.dst) == arrays.end()) arrays.push_back(k.dst);
+        for (size_t i = 0; i < arrays.size(); i++)
+            for (size_t j = i + 1; j < arrays.size(); j++)
+                if ((arrays[i]->param || arrays[i]->owner != cur) && (arrays[j]->param || arrays[j]->owner != cur))
+                    test += " && " + varRef(arrays[i], cur) + " != " + varRef(arrays[j], cur);
+    }
+    std::string args = iv + ", " + hi + ", " + varRef(k.acc ? k.acc : k.dst, cur);
+    for (const CVar *v : k.sources)
+        if (v != k.dst) args += ", " + varRef(v, cur);
+    for (const CVar *v : k.scalars) args += ", " + varRef(v, cur);
+    std::string call = "dana_kernel_" + std::to_string(k.id) + "(" + args + ");";
+    line(depth, "if (" + test + ") {");
+    line(depth + 1, k.acc ? varRef(k.acc, cur) + " = " + call : call);
+    line(depth + 1, iv + " = " + hi + ";");
+    line(depth, "}");
+}
+
+void CEmitter::emitProfileTables() {
+    const std::vector<ProfileSite> &sites = opts.profile->sites();
+    out << "static unsigned long long dana_counts[" << sites.size() << "];\n";
+    out << "static const char dana_kinds[] = \"";
+    for (auto &s : sites) out << (char)s.kind;
+    out << "\";\n";
+    out << "static const char *const dana_funcs[] = {";
+    for (size_t i = 0; i < sites.size(); i++) out << (i % 8 ? " " : "\n    ") << "\"" << sites[i].func << "\",";
+    out << "\n};\n";
+    out << "static const int dana_lines[] = {";
+    for (size_t i = 0; i < sites.size(); i++) out << (i % 16 ? " " : "\n    ") << sites[i].line << ",";
+    out << "\n};\n\n";
+}
+
+void CEmitter::run(fdefNode *root) {
+    if (opts.loops) plans = planLoops(root);
+    if (opts.module.empty()) resolveFunc(declareFunc(root->head, nullptr), root);
+    else {
+        scopes.emplace_back(); // the module body holds only definitions, which become top-level exports
+        resolveStmts(nullptr, root->body);
+        scopes.pop_back();
+    }
+    resolveCalls();
+    linkFrames();
+    if (opts.hints && opts.profile) chooseInlined();
+
+    out << "/* Generated by dana --emit-c. */\n";
+    out << "#include \"danart.h\"\n\n";
+    if (opts.imports)
+        for (const Interface &iface : *opts.imports)
+            out << "/* import " << iface.module << " (interface " << iface.hash << ") */\n";
+    for (const CFunc *fn : imported) out << prototype(fn) << ";\n";
+    if (!imported.empty()) out << "\n";
+    if (opts.instrument && opts.profile) emitProfileTables();
+
+    for (const CFunc *fn : funcs)
+        if (fn->frame) out << "struct " << frameName(fn) << ";\n";
+    for (const CFunc *fn : funcs)
+        out << prototype(fn) << ";\n";
+    out << "\n";
+    for (const CFunc *fn : funcs)
+        if (fn->frame) emitFrame(fn);
+    if (opts.vectorize && !opts.instrument)
+        for (const CFunc *fn : funcs) collectKernels(fn->def->body);
+    for (const CKernel &k : kernels) emitKernel(k);
+    for (const CFunc *fn : funcs) emitFunc(fn);
+    if (!opts.module.empty()) return;
+
+    out << "int main(void) {\n";
+    line(1, funcs.front()->cname + "();");
+    if (opts.instrument && opts.profile) {
+        std::ostringstream write;
+        write << "dana_profile_write(" << stringLiteral("\"" + opts.profilePath + "\"") << ", " << opts.profile->checksum()
+              << "ULL, " << opts.profile->sites().size() << ", dana_counts, dana_kinds, dana_funcs, dana_lines);";
+        line(1, write.str());
+    }
+    line(1, "return 0;");
+    out << "}\n";
+}
+
+void emitC(fdefNode *root, std::ostream &out, const CEmitOptions &opts) {
+    CEmitter(out, opts).run(root);
+}
@@ -0,0 +1,31 @@
+#ifndef CGEN_HPP
+#define CGEN_HPP
+
+#include <iostream>
+#include <string>
+#include "ast.hpp"
+#include "profile.hpp"
+#include "iface.hpp"
+
+/*
+ * C99 backend. The checked program is translated into one C file that includes
+ * runtime/danart.h and links against runtime/danart.c. Nested functions become
+ * top-level static functions that receive a pointer to their parent's frame, a
+ * struct holding the parent's variables that nested code refers to. Module
+ * exports and imported functions are external, named m_<module>_<function>.
+ */
+
+struct CEmitOptions {
+    const Profile *profile = nullptr; // sites numbered by Profile::collect
+    bool instrument = false;          // count sites and write them to profilePath at exit
+    bool hints = false;               // turn loaded profile counts into hot/cold, inlining and branch hints
+    bool loops = true;                // hoist invariants and strength-reduce indices (loop.hpp)
+    bool vectorize = true;            // run the loops planned as vector kernels through them
+    std::string profilePath;
+    std::string module;                           // non-empty: emit the module's exports and no main()
+    const std::vector<Interface> *imports = nullptr; // modules whose exports the program calls
+};
+
+void emitC(fdefNode *root, std::ostream &out, const CEmitOptions &opts);
+
+#endif
@@ -0,0 +1,181 @@
+#include "iface.hpp"
+#include <fstream>
+#include <sstream>
+
+/*
+ * File format: a header line `dana-interface 1 <module> <hash> <count>` and one
+ * line per export, `<name> <result> [<param>:<type> ...]`. Types are written as
+ * `int`, `byte`, `ref.int`, `byte[]` or `int[][10]`, dimensions in source order.
+ */
+
+static std::string typeText(typeClass *t) {
+    if (t->isRef()) return "ref." + typeText(static_cast<refType*>(t)->getBaseType());
+    std::string dims;
+    while (t->isArray()) {
+        arrayType *a = static_cast<arrayType*>(t);
+        dims = "[" + (a->getSize() ? std::to_string(a->getSize()->value) : std::string()) + "]" + dims;
+        t = a->getBaseType();
+    }
+    switch (t->getType()) {
+        case TYPE_INT: return "int" + dims;
+        case TYPE_VOID: return "void" + dims;
+        default: return "byte" + dims;
+    }
+}
+
+/* Inverse of typeText; returns nullptr on malformed input. */
+static typeClass *parseType(std::string text) {
+    bool ref = text.compare(0, 4, "ref.") == 0;
+    if (ref) text = text.substr(4);
+    size_t bracket = text.find('[');
+    std::string base = text.substr(0, bracket);
+    typeClass *t;
+    if (base == "int") t = new basicType(TYPE_INT);
+    else if (base == "byte") t = new basicType(TYPE_CHAR);
+    else if (base == "void" && bracket == std::string::npos && !ref) return new basicType(TYPE_VOID);
+    else return nullptr;
+    if (ref) {
+        if (bracket == std::string::npos) return new refType(t);
+        freeType(t);
+        return nullptr;
+    }
+
+    while (bracket != std::string::npos) {
+        size_t close = text.find(']', bracket);
+        std::string size = close == std::string::npos ? std::string() : text.substr(bracket + 1, close - bracket - 1);
+        if (close == std::string::npos || size.find_first_not_of("0123456789") != std::string::npos) {
+            freeType(t);
+            return nullptr;
+        }
+        t = new arrayType(t, size.empty() ? nullptr : new Const(std::stoi(size)));
+        bracket = close + 1 < text.size() ? close + 1 : std::string::npos;
+        if (bracket != std::string::npos && text[bracket] != '[') {
+            freeType(t);
+            return nullptr;
+        }
+    }
+    return t;
+}
+
+static std::string exportLine(headerNode *h) {
+    std::string line = h->iden->name + " " + typeText(h->headType);
+    for (paramNode *p = h->params; p; p = p->tail)
+        for (auto &name : *p->names) line += " " + name + ":" + typeText(p->types);
+    return line;
+}
+
+static unsigned long long hashLines(const std::vector<std::string> &lines) {
+    unsigned long long h = 1469598103934665603ULL;
+    for (auto &line : lines)
+        for (char c : line + "\n") h = (h ^ (unsigned char)c) * 1099511628211ULL;
+    return h;
+}
+
+static std::string render(const Interface &iface, const std::vector<std::string> &lines) {
+    std::ostringstream out;
+    out << "dana-interface 1 " << iface.module << " " << iface.hash << " " << lines.size() << "\n";
+    for (auto &line : lines) out << line << "\n";
+    return out.str();
+}
+
+bool moduleInterface(fdefNode *root, Interface &iface, std::string &error) {
+    iface.module = root->head->iden->name;
+    iface.exports.clear();
+    if (root->head->params) {
+        error = "module '" + iface.module + "' may not take parameters (line " + std::to_string(root->head->lineno) + ")";
+        return false;
+    }
+    std::vector<std::string> lines;
+    for (stmtNode *stmt = root->body; stmt; stmt = stmt->stmtTail) {
+        if (stmt->stmtType == "def") {
+            iface.exports.push_back(stmt->funcDef->head);
+            lines.push_back(exportLine(stmt->funcDef->head));
+        }
+        else if (stmt->stmtType != "decl" && stmt->stmtType != "skip") {
+            error = "module '" + iface.module + "' may only contain function definitions (line " + std::to_string(stmt->lineno) + ")";
+            return false;
+        }
+    }
+    iface.hash = hashLines(lines);
+    return true;
+}
+
+bool writeInterface(const std::string &path, const Interface &iface, bool &changed, std::string &error) {
+    std::vector<std::string> lines;
+    for (headerNode *h : iface.exports) lines.push_back(exportLine(h));
+    std::string text = render(iface, lines);
+
+    std::ifstream old(path);
+    std::stringstream current;
+    if (old) current << old.rdbuf();
+    changed = !old || current.str() != text;
+    if (!changed) return true; // keep the timestamp so importers are not rebuilt
+
+    std::ofstream out(path);
+    if (!(out << text)) {
+        error = "cannot write interface '" + path + "'";
+        return false;
+    }
+    return true;
+}
+
+/* Frees the exports read so far once the file turns out to be bad. */
+static void dropExports(Interface &iface) {
+    for (headerNode *h : iface.exports) freeHeader(h);
+    iface.exports.clear();
+}
+
+bool readInterface(const std::string &path, Interface &iface, std::string &error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open interface '" + path + "'";
+        return false;
+    }
+    std::string magic;
+    int version = 0;
+    size_t count = 0;
+    if (!(in >> magic >> version >> iface.module >> iface.hash >> count) || magic != "dana-interface" || version != 1) {
+        error = "'" + path + "' is not a Dana interface";
+        return false;
+    }
+    std::string line;
+    std::getline(in, line);
+    std::vector<std::string> lines;
+    iface.exports.clear();
+    while (lines.size() < count && std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name, result, param;
+        fields >> name >> result;
+        headerNode *h = new headerNode(parseType(result), nullptr, new Id(name));
+        paramNode *last = nullptr;
+        bool ok = !name.empty() && h->headType && !h->headType->isArray() && !h->headType->isRef();
+        while (ok && fields >> param) {
+            size_t colon = param.find(':');
+            typeClass *t = colon == std::string::npos ? nullptr : parseType(param.substr(colon + 1));
+            if (!t || (t->getType() == TYPE_VOID)) {
+                freeType(t);
+                ok = false;
+                break;
+            }
+            paramNode *p = new paramNode(new std::vector<std::string>{param.substr(0, colon)}, t, nullptr);
+            p->ref = t->isRef();
+            if (last) last->tail = p;
+            else h->params = p;
+            last = p;
+        }
+        if (!ok) {
+            freeHeader(h);
+            dropExports(iface);
+            error = "malformed interface line in '" + path + "': " + line;
+            return false;
+        }
+        iface.exports.push_back(h);
+        lines.push_back(line);
+    }
+    if (lines.size() != count || hashLines(lines) != iface.hash) {
+        dropExports(iface);
+        error = "interface '" + path + "' is truncated or corrupt";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef IFACE_HPP
+#define IFACE_HPP
+
+#include <string>
+#include <vector>
+#include "ast.hpp"
+
+/*
+ * Separate compilation. A module is a program whose outermost def contains only
+ * function definitions (and `skip`); those functions are its exports. Compiling
+ * it with --emit-interface writes their headers to a small interface file that
+ * other programs load with --import instead of parsing the module's source.
+ * The interface is only rewritten when its hash changes, so build tools see an
+ * unchanged timestamp after implementation-only edits and skip the importers.
+ */
+
+struct Interface {
+    std::string module;
+    std::vector<headerNode*> exports;
+    unsigned long long hash = 0; // FNV-1a over the export lines
+};
+
+bool moduleInterface(fdefNode *root, Interface &iface, std::string &error);
+bool writeInterface(const std::string &path, const Interface &iface, bool &changed, std::string &error);
+bool readInterface(const std::string &path, Interface &iface, std::string &error);
+
+#endif
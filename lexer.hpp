@@ -1,2 +1,3 @@
 int yylex();
+void lexerRestart(FILE *in);
 void yyerror(const char *msg);
\ No newline at end of file
@@ -0,0 +1,568 @@
+#include "loop.hpp"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <set>
+#include <map>
+#include <functional>
+#include <algorithm>
+
+/*
+ * Loop analysis over the checked AST. Dana only has the unstructured `loop`, so
+ * counted loops are recovered from their exit test: a leading `if c: break` or
+ * `if c: ... else: break`. For every loop the pass finds the induction variables
+ * and plans the invariant expressions, row addresses and index products the C
+ * backend moves out of the loop, and recognizes counted loops that run one
+ * element-wise statement (fill, copy, map, sum), which the backend turns into
+ * vector kernels. The report adds the exit condition.
+ */
+
+struct FuncInfo {
+    std::string name;
+    std::set<std::string> locals;                             // parameters and local variables
+    std::map<const headerNode*, std::set<std::string>> nestedFuncs; // nested function -> locals it can see
+    std::map<std::string, typeClass*> types;                  // types of parameters and locals
+    std::set<std::string> params;
+    std::set<std::string> refs;                               // ref parameters
+};
+
+struct LoopInfo {
+    std::map<std::string, int> assigns; // scalar assignments per variable
+    std::set<std::string> clobbered;    // may change through a ref argument or a nested function
+    std::set<std::string> arraysWritten;
+    bool writesNonLocals = false;       // calls a user function
+    bool writesAliased = false;         // assigns a ref parameter or a variable of an enclosing function
+};
+
+/* The loop's induction variables and the statements that run on every iteration. */
+struct LoopShape {
+    exprNode *exit = NULL;
+    bool negated = false;               // the loop runs while exit holds
+    std::vector<stmtNode*> body;
+    std::map<std::string, LoopReduction> ivs; // product and factor unset
+    std::map<std::string, stmtNode*> unitIvs; // step +1, with their update
+};
+
+static std::string str(const Node &n) {
+    std::ostringstream os;
+    os << n;
+    return os.str();
+}
+
+static bool isBuiltin(const headerNode *target) {
+    for (headerNode *h : preludeHeaders())
+        if (h == target) return true;
+    return false;
+}
+
+/* Records every function defined under stmt as able to see the given locals. */
+static void collectFuncs(stmtNode *stmt, const std::set<std::string> &visible, FuncInfo &fn) {
+    for (; stmt; stmt = stmt->stmtTail) {
+        if (stmt->stmtType == "def" || stmt->stmtType == "decl") {
+            fn.nestedFuncs[stmt->funcDef->head] = visible;
+            collectFuncs(stmt->funcDef->body, visible, fn);
+        }
+        else if (stmt->stmtType == "loop") collectFuncs(stmt->stmtBody, fn.locals, fn);
+        else if (stmt->stmtType == "if")
+            for (ifNode *n = stmt->ifnode; n; n = n->tail) collectFuncs(n->stmt, fn.locals, fn);
+    }
+}
+
+static void scanStmts(stmtNode *stmt, const FuncInfo &fn, LoopInfo &info);
+
+static void scanExpr(exprNode *e, const FuncInfo &fn, LoopInfo &info) {
+    if (!e) return;
+    if (e->op == 'i' && e->lval)
+        for (exprNode *idx : *e->lval->ind) scanExpr(idx, fn, info);
+    if (e->op == 'f' && e->func) {
+        const std::string &callee = e->func->iden->name;
+        const headerNode *target = e->func->target; // the semantic check ran first
+        std::vector<exprNode*> args = e->func->args ? *e->func->args : std::vector<exprNode*>();
+        bool builtin = isBuiltin(target);
+        if (!builtin) {
+            info.writesNonLocals = true;
+            auto nested = fn.nestedFuncs.find(target);
+            if (nested != fn.nestedFuncs.end()) info.clobbered.insert(nested->second.begin(), nested->second.end());
+        }
+
+        std::vector<paramNode*> params; // one entry per argument position
+        if (target)
+            for (paramNode *p = target->params; p; p = p->tail)
+                for (size_t k = 0; k < p->names->size(); k++) params.push_back(p);
+
+        for (size_t i = 0; i < args.size(); i++) {
+            exprNode *arg = args[i];
+            scanExpr(arg, fn, info);
+            if (arg->op != 'i' || !arg->lval || arg->lval->isString) continue;
+            const std::string &name = arg->lval->ident->name;
+            if (builtin) {
+                if ((callee == "readString" && i == 1) || ((callee == "strcpy" || callee == "strcat") && i == 0))
+                    info.arraysWritten.insert(name);
+            }
+            else if (i >= params.size() || params[i]->types->isRef()) info.clobbered.insert(name);
+            else if (params[i]->types->isArray()) info.arraysWritten.insert(name);
+        }
+    }
+    scanExpr(e->leftExpr, fn, info);
+    scanExpr(e->rightExpr, fn, info);
+}
+
+static void scanStmts(stmtNode *stmt, const FuncInfo &fn, LoopInfo &info) {
+    for (; stmt; stmt = stmt->stmtTail) {
+        if (stmt->stmtType == "asgn") {
+            const std::string &name = stmt->lval->ident->name;
+            if (stmt->lval->ind->empty()) info.assigns[name]++;
+            else info.arraysWritten.insert(name);
+            if (!stmt->lval->isString && (fn.refs.count(name) || !fn.locals.count(name))) info.writesAliased = true;
+            for (exprNode *idx : *stmt->lval->ind) scanExpr(idx, fn, info);
+            scanExpr(stmt->exp, fn, info);
+        }
+        else if (stmt->stmtType == "pc" || stmt->stmtType == "return") scanExpr(stmt->exp, fn, info);
+        else if (stmt->stmtType == "loop") scanStmts(stmt->stmtBody, fn, info);
+        else if (stmt->stmtType == "if") {
+            for (ifNode *n = stmt->ifnode; n; n = n->tail) {
+                scanExpr(n->cond, fn, info);
+                scanStmts(n->stmt, fn, info);
+            }
+        }
+    }
+}
+
+/* An array parameter or an array of an enclosing function may be one a ref parameter points into. */
+static bool writesSharedArray(const FuncInfo &fn, const LoopInfo &info) {
+    for (auto &a : info.arraysWritten)
+        if (fn.params.count(a) || !fn.locals.count(a)) return true;
+    return false;
+}
+
+/* A ref parameter may name any variable of the callers, so it changes with every write that could reach one. */
+static bool isVariant(const std::string &name, const FuncInfo &fn, const LoopInfo &info) {
+    if (info.assigns.count(name) || info.clobbered.count(name)) return true;
+    bool outside = fn.refs.count(name) || !fn.locals.count(name);
+    return outside && (info.writesNonLocals || info.writesAliased || !info.clobbered.empty() || writesSharedArray(fn, info));
+}
+
+static bool isInvariant(exprNode *e, const FuncInfo &fn, const LoopInfo &info) {
+    if (!e) return true;
+    switch (e->op) {
+        case 'c': case 'x': case 'b': return true;
+        case 'i': return e->lval && !e->lval->isString && e->lval->ind->empty() && !isVariant(e->lval->ident->name, fn, info);
+        case 'f': return false;
+        default: return isInvariant(e->leftExpr, fn, info) && isInvariant(e->rightExpr, fn, info);
+    }
+}
+
+static bool isLeaf(exprNode *e) {
+    return e->op == 'c' || e->op == 'x' || e->op == 'b' || e->op == 'i' || e->op == 'f';
+}
+
+static bool canTrap(exprNode *e) {
+    if (!e) return false;
+    if (e->op == '/' || e->op == '%') return true;
+    return canTrap(e->leftExpr) || canTrap(e->rightExpr);
+}
+
+static bool isVar(exprNode *e, const std::string &name) {
+    return e && e->op == 'i' && e->lval && !e->lval->isString && e->lval->ind->empty() && e->lval->ident->name == name;
+}
+
+static bool readsVariable(exprNode *e) {
+    if (!e) return false;
+    return (e->op == 'i' && e->lval && !e->lval->isString) || readsVariable(e->leftExpr) || readsVariable(e->rightExpr);
+}
+
+/* Integer arithmetic over constants and int variables of this function; comparisons and bytes are not. */
+static bool isIntExpr(exprNode *e, const FuncInfo &fn) {
+    if (!e) return true;
+    switch (e->op) {
+        case 'c': return true;
+        case 'i': {
+            if (!e->lval || e->lval->isString || !e->lval->ind->empty()) return false;
+            auto t = fn.types.find(e->lval->ident->name);
+            return t != fn.types.end() && !t->second->isArray() && t->second->getType() == TYPE_INT;
+        }
+        case '+': case '-': case '*': case '/': case '%': return isIntExpr(e->leftExpr, fn) && isIntExpr(e->rightExpr, fn);
+        default: return false;
+    }
+}
+
+static bool isBreak(stmtNode *stmt, stmtNode *loop) {
+    if (!stmt || stmt->stmtType != "break") return false;
+    return !stmt->tag || (loop->tag && stmt->tag->name == loop->tag->name);
+}
+
+/*
+ * Plans one loop. Invariant expressions that read a variable move in front of the
+ * loop; one that can trap (/ or %) only from the leading condition, which every
+ * entry evaluates before anything else, and not from the right of `and`/`or`.
+ * Nodes in `replaced` are already taken over by an enclosing loop.
+ */
+struct LoopPlanner {
+    const FuncInfo &fn;
+    const LoopInfo &info;
+    const LoopShape &shape;
+    const std::set<const Node*> &replaced;
+    LoopPlan plan;
+    std::map<std::string, size_t> seen;
+
+    void invariant(exprNode *e) {
+        auto it = seen.emplace("inv " + str(*e), plan.invariants.size());
+        if (it.second) plan.invariants.push_back(e);
+        plan.invariantOf[e] = it.first->second;
+    }
+
+    bool reduction(exprNode *e) {
+        if (e->op != '*' || !e->leftExpr) return false;
+        for (int side = 0; side < 2; side++) {
+            exprNode *var = side ? e->rightExpr : e->leftExpr, *factor = side ? e->leftExpr : e->rightExpr;
+            if (var->op != 'i' || !var->lval || !var->lval->ind->empty()) continue;
+            auto iv = shape.ivs.find(var->lval->ident->name);
+            if (iv == shape.ivs.end() || !isVar(var, iv->first)) continue;
+            if (!isInvariant(factor, fn, info) || canTrap(factor) || !isIntExpr(factor, fn)) continue;
+            if (factor->op == 'c' && factor->constant->value == 1) continue;
+            auto it = seen.emplace("red " + str(*e), plan.reductions.size());
+            if (it.second) {
+                LoopReduction r = iv->second;
+                r.product = e;
+                r.factor = factor;
+                plan.reductions.push_back(r);
+            }
+            plan.reductionOf[e] = it.first->second;
+            return true;
+        }
+        return false;
+    }
+
+    void expr(exprNode *e, bool mayTrap, bool index) {
+        if (!e || replaced.count(e)) return;
+        if (e->op == 'i') {
+            lval(e->lval);
+            return;
+        }
+        if (e->op == 'f') {
+            if (e->func->args)
+                for (exprNode *arg : *e->func->args) expr(arg, false, false);
+            return;
+        }
+        if (isLeaf(e)) return;
+        if (index && reduction(e)) return;
+        if (isInvariant(e, fn, info) && readsVariable(e) && (mayTrap || !canTrap(e))) {
+            invariant(e);
+            return;
+        }
+        expr(e->leftExpr, mayTrap, index);
+        expr(e->rightExpr, mayTrap && e->op != 'a' && e->op != 'o', index);
+    }
+
+    /* a[i]..[j][k] with invariant, non-trapping i..j: the row address a[i]..[j] moves out. */
+    void lval(lvalNode *l) {
+        if (!l || l->isString) return;
+        size_t n = l->ind->size();
+        bool row = n >= 2 && !replaced.count(l);
+        std::string key = "row " + l->ident->name;
+        for (size_t i = 0; row && i + 1 < n; i++) {
+            exprNode *idx = (*l->ind)[i];
+            row = isInvariant(idx, fn, info) && !canTrap(idx);
+            key += "[" + str(*idx) + "]";
+        }
+        if (row) {
+            auto it = seen.emplace(key, plan.rows.size());
+            if (it.second) plan.rows.push_back(l);
+            plan.rowOf[l] = it.first->second;
+            expr(l->ind->back(), false, true);
+            return;
+        }
+        for (exprNode *idx : *l->ind) expr(idx, false, true);
+    }
+
+    void stmts(stmtNode *stmt, bool leading) {
+        for (; stmt; stmt = stmt->stmtTail, leading = false) {
+            if (stmt->stmtType == "asgn") {
+                lval(stmt->lval);
+                expr(stmt->exp, false, false);
+            }
+            else if (stmt->stmtType == "pc" || stmt->stmtType == "return") expr(stmt->exp, false, false);
+            else if (stmt->stmtType == "loop") stmts(stmt->stmtBody, false);
+            else if (stmt->stmtType == "if")
+                for (ifNode *n = stmt->ifnode; n; n = n->tail) {
+                    expr(n->cond, leading && n == stmt->ifnode, false);
+                    stmts(n->stmt, false);
+                }
+        }
+    }
+};
+
+/* Returns the array indexed by exactly iv (a[iv]) with a scalar element type, or NULL. */
+static lvalNode *unitAccess(lvalNode *l, const std::string &iv) {
+    if (!l || l->isString || l->ind->size() != 1) return NULL;
+    return isVar((*l->ind)[0], iv) ? l : NULL;
+}
+
+static lvalNode *unitAccess(exprNode *e, const std::string &iv) {
+    return e && e->op == 'i' ? unitAccess(e->lval, iv) : NULL;
+}
+
+static Type elementType(const std::string &array, const FuncInfo &fn) {
+    auto t = fn.types.find(array);
+    if (t == fn.types.end() || !t->second->isArray()) return TYPE_VOID;
+    typeClass *base = static_cast<arrayType*>(t->second)->getBaseType();
+    return base->isArray() ? TYPE_VOID : base->getType();
+}
+
+/* Element-wise expression: only a[iv] reads, invariants and non-trapping integer operators. */
+static bool elementWise(exprNode *e, const std::string &iv, const FuncInfo &fn, const LoopInfo &info,
+                        std::vector<std::string> &sources) {
+    if (!e) return true;
+    if (lvalNode *a = unitAccess(e, iv)) {
+        sources.push_back(a->ident->name);
+        return true;
+    }
+    if (e->op == 'f' || e->op == '/' || e->op == '%') return false;
+    if (isLeaf(e)) return isInvariant(e, fn, info);
+    return elementWise(e->leftExpr, iv, fn, info, sources) && elementWise(e->rightExpr, iv, fn, info, sources);
+}
+
+/*
+ * Counted loop `iv` from its entry value while `iv < bound` (or <=) with step +1:
+ * the exit test must compare the induction variable against an invariant.
+ */
+static exprNode *countedBound(exprNode *exit, bool negated, const std::string &iv, const FuncInfo &fn, const LoopInfo &info,
+                              bool &inclusive) {
+    if (!exit || !exit->leftExpr) return NULL;
+    char op = exit->op;
+    exprNode *bound = NULL;
+    if (isVar(exit->leftExpr, iv)) {
+        bound = exit->rightExpr;
+        if (!(negated ? (op == '<' || op == 'l') : (op == '>' || op == 'g'))) return NULL;
+        inclusive = op == 'l' || op == '>';
+    }
+    else if (isVar(exit->rightExpr, iv)) {
+        bound = exit->leftExpr;
+        if (!(negated ? (op == '>' || op == 'g') : (op == '<' || op == 'l'))) return NULL;
+        inclusive = op == 'g' || op == '<';
+    }
+    return bound && isInvariant(bound, fn, info) ? bound : NULL;
+}
+
+/* Reads a ref parameter or a scalar of an enclosing function. */
+static bool readsShared(exprNode *e, const FuncInfo &fn) {
+    if (!e) return false;
+    if (e->op == 'i' && e->lval && !e->lval->isString && e->lval->ind->empty()) {
+        const std::string &name = e->lval->ident->name;
+        return fn.refs.count(name) || !fn.locals.count(name);
+    }
+    return readsShared(e->leftExpr, fn) || readsShared(e->rightExpr, fn);
+}
+
+static std::string vectorIdiom(stmtNode *stmt, const std::string &iv, const FuncInfo &fn, const LoopInfo &info,
+                               std::vector<std::string> &arrays) {
+    if (stmt->stmtType != "asgn") return "";
+    if (stmt->lval->ind->empty()) {
+        const std::string &acc = stmt->lval->ident->name;
+        exprNode *e = stmt->exp;
+        if (acc == iv || info.assigns.at(acc) != 1 || info.clobbered.count(acc) || e->op != '+' || !e->leftExpr) return "";
+        lvalNode *a = isVar(e->leftExpr, acc) ? unitAccess(e->rightExpr, iv) : isVar(e->rightExpr, acc) ? unitAccess(e->leftExpr, iv) : NULL;
+        if (!a) return "";
+        arrays.push_back(a->ident->name);
+        return "sum";
+    }
+    lvalNode *dst = unitAccess(stmt->lval, iv);
+    std::vector<std::string> sources;
+    if (!dst || !elementWise(stmt->exp, iv, fn, info, sources)) return "";
+    arrays.push_back(dst->ident->name);
+    arrays.insert(arrays.end(), sources.begin(), sources.end());
+    if (sources.empty()) return "fill";
+    return unitAccess(stmt->exp, iv) ? "copy" : "map";
+}
+
+/*
+ * A counted loop whose body is one element-wise statement over arrays of one
+ * scalar type, followed by the unit step of its induction variable.
+ */
+static bool vectorKernel(const LoopShape &shape, const FuncInfo &fn, const LoopInfo &info, LoopKernel &k) {
+    if (shape.body.size() != 2) return false;
+    stmtNode *work = shape.body[0], *update = shape.body[1];
+    if (update->stmtType != "asgn" || !update->lval->ind->empty()) return false;
+    auto iv = shape.unitIvs.find(update->lval->ident->name);
+    if (iv == shape.unitIvs.end() || iv->second != update) return false;
+    exprNode *bound = countedBound(shape.exit, shape.negated, iv->first, fn, info, k.inclusive);
+    if (!bound) return false;
+
+    std::vector<std::string> arrays;
+    k.idiom = vectorIdiom(work, iv->first, fn, info, arrays);
+    if (k.idiom.empty()) return false;
+    // The kernel takes its scalars by value, so none may live in an array the loop writes.
+    if (k.idiom != "sum" && writesSharedArray(fn, info) && readsShared(work->exp, fn)) return false;
+    std::sort(arrays.begin(), arrays.end());
+    arrays.erase(std::unique(arrays.begin(), arrays.end()), arrays.end());
+
+    k.elem = TYPE_VOID;
+    int shared = 0; // parameters and variables of enclosing functions, which may name the same array
+    for (auto &a : arrays) {
+        Type t = elementType(a, fn);
+        if (t == TYPE_VOID || fn.refs.count(a) || (k.elem != TYPE_VOID && t != k.elem)) return false;
+        k.elem = t;
+        if (fn.params.count(a) || !fn.locals.count(a)) shared++;
+    }
+    k.work = work;
+    k.update = update;
+    k.bound = bound;
+    k.aliasCheck = shared > 1;
+    return true;
+}
+
+/* Recovers the exit test, the statements that run on every iteration and the induction variables. */
+static void loopShape(stmtNode *loop, const FuncInfo &fn, const LoopInfo &info, LoopShape &shape) {
+    stmtNode *first = loop->stmtBody, *rest = first;
+    if (first && first->stmtType == "if" && first->ifnode->cond) {
+        ifNode *n = first->ifnode;
+        if (isBreak(n->stmt, loop) && !n->stmt->stmtTail) {
+            shape.exit = n->cond;
+            rest = first->stmtTail;
+        }
+        else if (n->tail && !n->tail->cond && !n->tail->tail && isBreak(n->tail->stmt, loop) && !n->tail->stmt->stmtTail) {
+            shape.exit = n->cond;
+            shape.negated = true;
+            for (stmtNode *s = n->stmt; s; s = s->stmtTail) shape.body.push_back(s);
+            rest = first->stmtTail;
+        }
+    }
+    for (stmtNode *s = rest; s; s = s->stmtTail) shape.body.push_back(s);
+
+    // Only the function's own int variables: nothing but the update can change them.
+    for (stmtNode *s : shape.body) {
+        if (s->stmtType != "asgn" || !s->lval->ind->empty()) continue;
+        const std::string &v = s->lval->ident->name;
+        auto type = fn.types.find(v);
+        if (info.assigns.at(v) != 1 || info.clobbered.count(v) || fn.refs.count(v) || type == fn.types.end() ||
+            type->second->isArray() || type->second->getType() != TYPE_INT) continue;
+        exprNode *e = s->exp;
+        if (!e->leftExpr || (e->op != '+' && e->op != '-')) continue;
+        exprNode *step = NULL;
+        if (isVar(e->leftExpr, v)) step = e->rightExpr;
+        else if (e->op == '+' && isVar(e->rightExpr, v)) step = e->leftExpr;
+        if (!step || !isInvariant(step, fn, info) || canTrap(step) || !isIntExpr(step, fn)) continue;
+        shape.ivs[v] = LoopReduction{NULL, NULL, s, step, e->op == '-'};
+        if (e->op == '+' && step->op == 'c' && step->constant->value == 1) shape.unitIvs[v] = s;
+    }
+}
+
+static void reportLoop(stmtNode *loop, int ordinal, const FuncInfo &fn, const LoopShape &shape,
+                       const LoopPlan &plan, std::ostream &out) {
+    stmtNode *first = loop->stmtBody;
+    int line = first ? (first->stmtType == "if" && first->ifnode->cond ? first->ifnode->cond->lineno : first->lineno) : loop->lineno;
+    out << fn.name << ": loop " << ordinal;
+    if (loop->tag) out << " '" << loop->tag->name << "'";
+    out << " (line " << line << ")" << std::endl;
+
+    for (auto &iv : shape.ivs)
+        out << "  induction variable " << iv.first << " (step " << (iv.second.down ? "-" : "+") << str(*iv.second.step) << ")" << std::endl;
+    if (shape.exit) out << "  exits when " << (shape.negated ? "not " : "") << str(*shape.exit) << std::endl;
+    else out << "  no leading exit test" << std::endl;
+
+    for (exprNode *e : plan.invariants) out << "  hoisted invariant " << str(*e) << std::endl;
+    for (lvalNode *l : plan.rows) {
+        out << "  hoisted row address " << l->ident->name;
+        for (size_t i = 0; i + 1 < l->ind->size(); i++) out << "[" << *(*l->ind)[i] << "]";
+        out << std::endl;
+    }
+    for (const LoopReduction &r : plan.reductions)
+        out << "  strength-reduced " << str(*r.product) << " to a running index (" << (r.down ? "-" : "+") << str(*r.step)
+            << " * " << str(*r.factor) << " per update of " << str(*r.update->lval) << ")" << std::endl;
+
+    if (plan.vector) {
+        const LoopKernel &k = plan.kernel;
+        int width = k.elem == TYPE_INT ? 4 : 1;
+        out << "  vector kernel: " << k.idiom << " " << str(*k.work) << " (" << (k.elem == TYPE_INT ? "int" : "byte") << ", "
+            << 16 / width << " lanes SSE2 / " << 32 / width << " lanes AVX2, " << (k.bound->op == 'c' ? "constant" : "runtime")
+            << " trip count to " << (k.inclusive ? "<= " : "< ") << str(*k.bound);
+        if (k.aliasCheck) out << ", runtime alias check";
+        out << ")" << std::endl;
+    }
+}
+
+typedef std::function<void(stmtNode *loop, int ordinal, const FuncInfo &fn, const LoopInfo &info,
+                           const LoopShape &shape, const LoopPlan &plan)> LoopVisitor;
+
+static void walkFunc(fdefNode *func, const LoopVisitor &visit);
+
+static void walkStmts(stmtNode *stmt, const FuncInfo &fn, const std::set<const Node*> &replaced, int &ordinal,
+                      const LoopVisitor &visit) {
+    for (; stmt; stmt = stmt->stmtTail) {
+        if (stmt->stmtType == "loop") {
+            LoopInfo info;
+            scanStmts(stmt->stmtBody, fn, info);
+            LoopShape shape;
+            loopShape(stmt, fn, info, shape);
+            LoopPlanner planner{fn, info, shape, replaced, LoopPlan(), {}};
+            planner.stmts(stmt->stmtBody, true);
+            planner.plan.vector = vectorKernel(shape, fn, info, planner.plan.kernel);
+            visit(stmt, ++ordinal, fn, info, shape, planner.plan);
+
+            std::set<const Node*> inner = replaced;
+            for (auto &e : planner.plan.invariantOf) inner.insert(e.first);
+            for (auto &l : planner.plan.rowOf) inner.insert(l.first);
+            for (auto &e : planner.plan.reductionOf) inner.insert(e.first);
+            walkStmts(stmt->stmtBody, fn, inner, ordinal, visit);
+        }
+        else if (stmt->stmtType == "if")
+            for (ifNode *n = stmt->ifnode; n; n = n->tail) walkStmts(n->stmt, fn, replaced, ordinal, visit);
+        else if (stmt->stmtType == "def") walkFunc(stmt->funcDef, visit);
+    }
+}
+
+static void walkFunc(fdefNode *func, const LoopVisitor &visit) {
+    FuncInfo fn;
+    fn.name = func->head->iden->name;
+    for (paramNode *p = func->head->params; p; p = p->tail)
+        for (auto &n : *p->names) {
+            fn.locals.insert(n);
+            fn.params.insert(n);
+            fn.types[n] = p->types;
+            if (p->types->isRef()) fn.refs.insert(n);
+        }
+
+    for (stmtNode *s = func->body; s; s = s->stmtTail) {
+        if (s->stmtType == "vardecl")
+            for (auto &n : *s->varNames) {
+                fn.locals.insert(n);
+                fn.types[n] = s->varType;
+            }
+    }
+
+    // A nested function sees only the locals declared before its def; calls name its decl's header when it has one.
+    std::set<std::string> visible;
+    std::map<std::string, const headerNode*> decls;
+    for (paramNode *p = func->head->params; p; p = p->tail) visible.insert(p->names->begin(), p->names->end());
+    stmtNode *s = func->body;
+    for (; s && (s->stmtType == "vardecl" || s->stmtType == "def" || s->stmtType == "decl"); s = s->stmtTail) {
+        if (s->stmtType == "vardecl") visible.insert(s->varNames->begin(), s->varNames->end());
+        else {
+            const std::string &name = s->funcDef->head->iden->name;
+            if (s->stmtType == "decl") decls[name] = s->funcDef->head;
+            else if (decls.count(name)) fn.nestedFuncs[decls[name]] = visible;
+            fn.nestedFuncs[s->funcDef->head] = visible;
+            collectFuncs(s->funcDef->body, visible, fn);
+        }
+    }
+    collectFuncs(s, fn.locals, fn);
+
+    int ordinal = 0;
+    walkStmts(func->body, fn, std::set<const Node*>(), ordinal, visit);
+}
+
+LoopPlans planLoops(fdefNode *root) {
+    LoopPlans plans;
+    walkFunc(root, [&](stmtNode *loop, int, const FuncInfo &, const LoopInfo &, const LoopShape &, const LoopPlan &plan) {
+        plans[loop] = plan;
+    });
+    return plans;
+}
+
+void loopReport(fdefNode *func, std::ostream &out) {
+    walkFunc(func, [&](stmtNode *loop, int ordinal, const FuncInfo &fn, const LoopInfo &,
+                                   const LoopShape &shape, const LoopPlan &plan) {
+        reportLoop(loop, ordinal, fn, shape, plan, out);
+    });
+}
@@ -0,0 +1,54 @@
+#ifndef LOOP_HPP
+#define LOOP_HPP
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "ast.hpp"
+
+/*
+ * Loop optimizations, planned over the checked AST and applied by the C backend.
+ * Loop-invariant expressions and invariant row addresses of multi-dimensional
+ * arrays are computed once before the loop; products `iv * k` in array indices,
+ * where iv is an induction variable and k is invariant, become a running index
+ * that is advanced next to the update of iv. A counted loop whose body is one
+ * element-wise statement over arrays becomes a vector kernel. --loop-report
+ * prints the same plan.
+ */
+
+struct LoopReduction {
+    exprNode *product; // iv * k or k * iv
+    exprNode *factor;  // k
+    stmtNode *update;  // the only assignment to iv in the loop: iv := iv +- step
+    exprNode *step;
+    bool down;         // iv := iv - step
+};
+
+struct LoopKernel {
+    std::string idiom;   // fill, copy, map or sum
+    stmtNode *work;      // the statement run for each value of iv, before update
+    stmtNode *update;    // iv := iv + 1
+    exprNode *bound;     // invariant
+    bool inclusive;      // the loop runs while iv <= bound, else while iv < bound
+    Type elem;           // element type of every array
+    bool aliasCheck;     // two of the arrays may be the same one
+};
+
+struct LoopPlan {
+    std::vector<exprNode*> invariants;             // one per distinct expression, in source order
+    std::map<const exprNode*, size_t> invariantOf; // every occurrence -> its entry
+    std::vector<lvalNode*> rows;                   // a[i]..[j] whose leading indices are invariant
+    std::map<const lvalNode*, size_t> rowOf;
+    std::vector<LoopReduction> reductions;
+    std::map<const exprNode*, size_t> reductionOf;
+    bool vector = false;
+    LoopKernel kernel;
+};
+
+typedef std::map<const stmtNode*, LoopPlan> LoopPlans;
+
+LoopPlans planLoops(fdefNode *root);
+void loopReport(fdefNode *func, std::ostream &out);
+
+#endif
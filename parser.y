@@ -1,12 +1,21 @@
 %{
 #include "ast.hpp"
 #include "lexer.hpp"
+#include "alloc.hpp"
+#include "profile.hpp"
+#include "cgen.hpp"
+#include "loop.hpp"
+#include "iface.hpp"
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <vector>
 #include <string>
 #include <stack>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sys/resource.h>
 
 #define RED "\033[1;31m"
 #define GREEN "\033[1;32m"
@@ -23,8 +32,29 @@ std::stack<fdefNode*> fNames;
 
 fdefNode *startFunc;
 
+/* --stream: each function is checked as soon as it is parsed, then its body is freed. */
+SymbolTable *streamSym = NULL;
+std::vector<bool> streaming;  // per open func_def: checked while parsing
+std::stack<int> outerBlocks;  // blockDepth of each enclosing func_def
+int blockDepth = 0;           // open if/loop bodies in the innermost func_def
+
+void beginFuncDef(headerNode *head);
+fdefNode *endFuncDef(stmtNode *body);
+void localDefParsed(stmtNode *def);
+
 %}
 
+%code requires {
+      class stmtNode;
+      class paramNode;
+      class ifNode;
+
+      /* Head/last pairs let left-recursive list rules append in O(1). */
+      struct stmtChain { stmtNode *head; stmtNode *last; };
+      struct paramChain { paramNode *head; paramNode *last; };
+      struct ifChain { ifNode *head; ifNode *last; };
+}
+
 %union{
       fdefNode *func;
       exprNode *expr;
@@ -37,6 +67,9 @@ fdefNode *startFunc;
       typeClass *types;
       std::vector<std::string> *idList;
       std::vector<exprNode*> *exprvec;
+      stmtChain stmts;
+      paramChain params;
+      ifChain ifs;
 
       int constval;
       char *idstr;
@@ -71,22 +104,27 @@ fdefNode *startFunc;
 %token T_leq "<="
 %token T_neq "<>"
 
+/* Lowest precedence first, as bison expects. */
 %nonassoc "def" "if" "loop" "break" "continue" "return"
-%nonassoc "not" '!'
+%left "or"
+%left "and"
+%nonassoc "not"
 %nonassoc '=' "<>" '<' '>' "<=" ">="
-%left '*' '/' '%' '&'
 %left '+' '-' '|'
-%left "and"
-%left "or"
+%left '*' '/' '%' '&'
+%nonassoc '!'
 
 %type<func> program func_def func_decl
-%type<stmt> stmt stmt_list local_def local_def_list loop
+%type<stmt> stmt local_def local_def_list loop block
+%type<stmts> stmt_list local_defs
 %type<expr> expr cond
 %type<exprvec> expr_list
 %type<funcCall> func_call proc_call
-%type<ifStmt> if_stmts opt_elif_else
+%type<ifStmt> if_stmts
+%type<ifs> elif_list
 %type<header> header
-%type<param> opt_fpar
+%type<param> opt_fpar fpar
+%type<params> fpar_list
 %type<types> fpar_type ref_data_type array_type type data_type
 %type<idList> id_list
 %type<lval> l_value
@@ -104,7 +142,7 @@ program
       ;
 
 func_def
-      : T_def header { fNames.push(new fdefNode($2, NULL)); } local_def_list auto_end                 { $$ = new fdefNode($2, $4); fNames.pop(); }
+      : T_def header { beginFuncDef($2); } local_def_list auto_end                                     { $$ = endFuncDef($4); }
       ;
 
 func_decl
@@ -112,17 +150,24 @@ func_decl
       ;
 
 header
-      : T_id "is" type ':' opt_fpar                                                                   { $$ = new headerNode($3, $5, new Id($1)); }
-      | T_id "is" type                                                                                { $$ = new headerNode($3, NULL, new Id($1)); }
-      | T_id ':' opt_fpar                                                                             { $$ = new headerNode(new basicType(TYPE_VOID), $3, new Id($1)); }
-      | T_id                                                                                          { $$ = new headerNode(new basicType(TYPE_VOID), NULL, new Id($1)); }
+      : T_id "is" type ':' opt_fpar                                                                   { $$ = new headerNode($3, $5, new Id($1)); allocFree($1); }
+      | T_id "is" type                                                                                { $$ = new headerNode($3, NULL, new Id($1)); allocFree($1); }
+      | T_id ':' opt_fpar                                                                             { $$ = new headerNode(new basicType(TYPE_VOID), $3, new Id($1)); allocFree($1); }
+      | T_id                                                                                          { $$ = new headerNode(new basicType(TYPE_VOID), NULL, new Id($1)); allocFree($1); }
       ;
 
 opt_fpar
+      : fpar_list                                                                                     { $$ = $1.head; }
+      ;
+
+fpar_list
+      : fpar                                                                                          { $$.head = $1; $$.last = $1; }
+      | fpar_list ',' fpar                                                                            { $1.last->tail = $3; $$.head = $1.head; $$.last = $3; }
+      ;
+
+fpar
       : id_list "as" ref_data_type                                                                    { $$ = new paramNode($1, $3, NULL); $$->ref = true; }
       | id_list "as" fpar_type                                                                        { $$ = new paramNode($1, $3, NULL); $$->ref = false; }
-      | id_list "as" ref_data_type ',' opt_fpar                                                       { $$ = new paramNode($1, $3, $5); $$->ref = true; }
-      | id_list "as" fpar_type ',' opt_fpar                                                           { $$ = new paramNode($1, $3, $5); $$->ref = false; }
       ;
 
 fpar_type
@@ -145,8 +190,8 @@ array_type
       ; 
 
 stmt_list
-      : stmt                                                                                          { $1->stmtTail = NULL; $$ = $1; }
-      | stmt stmt_list                                                                                { $1->stmtTail = $2; $$ = $1; } 
+      : stmt                                                                                          { $1->stmtTail = NULL; $$.head = $1; $$.last = $1; }
+      | stmt_list stmt                                                                                { $2->stmtTail = NULL; $1.last->stmtTail = $2; $$.head = $1.head; $$.last = $2; }
       ;
 
 type
@@ -160,15 +205,21 @@ data_type
       ;
 
 local_def_list
-      : T_begin stmt_list T_end                                                                       { $$ = $2; }
-      | stmt_list                                                                                     { $$ = $1; }
-      | local_def local_def_list                                                                      { $$ = $1; $1->stmtTail = $2; }
+      : T_begin stmt_list T_end                                                                       { $$ = $2.head; }
+      | stmt_list                                                                                     { $$ = $1.head; }
+      | local_defs T_begin stmt_list T_end                                                            { $1.last->stmtTail = $3.head; $$ = $1.head; }
+      | local_defs stmt_list                                                                          { $1.last->stmtTail = $2.head; $$ = $1.head; }
+      ;
+
+local_defs
+      : local_def                                                                                     { $1->stmtTail = NULL; $$.head = $1; $$.last = $1; }
+      | local_defs local_def                                                                          { $2->stmtTail = NULL; $1.last->stmtTail = $2; $$.head = $1.head; $$.last = $2; }
       ;
 
 local_def
       : func_def                                                                                      { $$ = new stmtNode("def", NULL, NULL, NULL); $$->funcDef = $1; }
-      | func_decl                                                                                     { $$ = new stmtNode("decl", NULL, NULL, NULL); $$->funcDef = $1; }
-      | "var" id_list "is" type                                                                       { $$ = new stmtNode("vardecl", NULL, NULL, NULL); $$->varNames = $2; $$->varType = $4; }
+      | func_decl                                                                                     { $$ = new stmtNode("decl", NULL, NULL, NULL); $$->funcDef = $1; localDefParsed($$); }
+      | "var" id_list "is" type                                                                       { $$ = new stmtNode("vardecl", NULL, NULL, NULL); $$->varNames = $2; $$->varType = $4; localDefParsed($$); }
       ;
 
 stmt
@@ -180,41 +231,50 @@ stmt
       | if_stmts                                                                                      { $$ = new stmtNode("if", NULL, NULL, NULL); $$->ifnode = $1; }
       | loop                                                                                          { $$ = $1; }
       | "break"                                                                                       { $$ = new stmtNode("break", NULL, NULL, NULL); }
-      | "break" ':' T_id                                                                              { $$ = new stmtNode("break", NULL, NULL, new Id($3)); }
+      | "break" ':' T_id                                                                              { $$ = new stmtNode("break", NULL, NULL, new Id($3)); allocFree($3); }
       | "continue"                                                                                    { $$ = new stmtNode("continue", NULL, NULL, NULL); }
-      | "continue" ':' T_id                                                                           { $$ = new stmtNode("continue", NULL, NULL, new Id($3)); }
+      | "continue" ':' T_id                                                                           { $$ = new stmtNode("continue", NULL, NULL, new Id($3)); allocFree($3); }
       ;
 
 if_stmts
-      : "if" cond ':' local_def_list auto_end "else" ':' local_def_list auto_end                      { $$ = new ifNode($2, $4); auto elseNode = new ifNode(NULL, $8); $$->tail = elseNode; elseNode->tail = NULL; }
-      | "if" cond ':' local_def_list auto_end "elif" cond ':' local_def_list auto_end opt_elif_else   { $$ = new ifNode($2, $4); auto elseNode = new ifNode($7, $9); $$->tail = elseNode; elseNode->tail = $11; }
-      | "if" cond ':' local_def_list auto_end                                                         { $$ = new ifNode($2, $4); $$->tail = NULL; }
+      : "if" cond ':' block "else" ':' block                                                          { $$ = new ifNode($2, $4); auto elseNode = new ifNode(NULL, $7); $$->tail = elseNode; elseNode->tail = NULL; }
+      | "if" cond ':' block elif_list "else" ':' block                                                { $$ = new ifNode($2, $4); $$->tail = $5.head; auto elseNode = new ifNode(NULL, $8); $5.last->tail = elseNode; elseNode->tail = NULL; }
+      | "if" cond ':' block elif_list                                                                 { $$ = new ifNode($2, $4); $$->tail = $5.head; }
+      | "if" cond ':' block                                                                           { $$ = new ifNode($2, $4); $$->tail = NULL; }
       ;
 
-opt_elif_else
-      : /* empty */                                                                                   { $$ = NULL; }
-      | "elif" cond ':' local_def_list auto_end opt_elif_else                                         { $$ = new ifNode($2, $4); $$->tail = $6; }
-      | "else" ':' local_def_list auto_end                                                            { $$ = new ifNode(NULL, $3); $$->tail = NULL; }
+elif_list
+      : "elif" cond ':' block                                                                         { $$.head = new ifNode($2, $4); $$.head->tail = NULL; $$.last = $$.head; }
+      | elif_list "elif" cond ':' block                                                               { auto n = new ifNode($3, $5); n->tail = NULL; $1.last->tail = n; $$.head = $1.head; $$.last = n; }
       ;
 
 loop
-      : "loop" T_id ':' local_def_list auto_end                                                       { $$ = new stmtNode("loop", $4, NULL, new Id($2)); }
-      | "loop" ':' local_def_list auto_end                                                            { $$ = new stmtNode("loop", $3, NULL, NULL); }
+      : "loop" T_id ':' block                                                                         { $$ = new stmtNode("loop", $4, NULL, new Id($2)); allocFree($2); }
+      | "loop" ':' block                                                                              { $$ = new stmtNode("loop", $3, NULL, NULL); }
+      ;
+
+/* Body of an if arm or a loop; definitions inside it are checked with the enclosing statement. */
+block
+      : block_open local_def_list auto_end                                                            { $$ = $2; blockDepth--; }
+      ;
+
+block_open
+      : /* empty */                                                                                   { blockDepth++; }
       ;
 
 proc_call
-      : T_id                                                                                          { $$ = new fcallNode(new Id($1)); $$->args = NULL; }
-      | T_id ':' expr_list                                                                            { $$ = new fcallNode(new Id($1)); $$->args = $3; }
+      : T_id                                                                                          { $$ = new fcallNode(new Id($1)); $$->args = NULL; allocFree($1); }
+      | T_id ':' expr_list                                                                            { $$ = new fcallNode(new Id($1)); $$->args = $3; allocFree($1); }
       ;
 
 func_call
-      : T_id '('')'                                                                                   { $$ = new fcallNode(new Id($1)); $$->args = NULL; }
-      | T_id '(' expr_list ')'                                                                        { $$ = new fcallNode(new Id($1)); $$->args = $3; }
+      : T_id '('')'                                                                                   { $$ = new fcallNode(new Id($1)); $$->args = NULL; allocFree($1); }
+      | T_id '(' expr_list ')'                                                                        { $$ = new fcallNode(new Id($1)); $$->args = $3; allocFree($1); }
       ;
 
 l_value
-      : T_id                                                                                          { $$ = new lvalNode(false, new Id($1)); }
-      | T_string                                                                                      { $$ = new lvalNode(true, new Id($1)); }
+      : T_id                                                                                          { $$ = new lvalNode(false, new Id($1)); allocFree($1); }
+      | T_string                                                                                      { $$ = new lvalNode(true, new Id($1)); allocFree($1); }
       | l_value '[' expr ']'                                                                          { $1->ind->push_back($3); $$ = $1; }
       ;
 
@@ -253,13 +313,13 @@ cond
       ;
 
 id_list
-      : T_id                                                                                          { $$ = new std::vector<std::string>(); $$->push_back($1); }
-      | id_list T_id                                                                                  { $1->push_back($2); $$ = $1; }
+      : T_id                                                                                          { $$ = new std::vector<std::string>(); $$->push_back($1); allocFree($1); }
+      | id_list T_id                                                                                  { $1->push_back($2); $$ = $1; allocFree($2); }
       ;
 
 expr_list
       : expr                                                                                          { $$ = new std::vector<exprNode*>(); $$->push_back($1); }
-      | expr ',' expr_list                                                                            { $3->insert($3->begin(), $1); $$ = $3; }
+      | expr_list ',' expr                                                                            { $1->push_back($3); $$ = $1; }
       ;
 
 %%
@@ -308,24 +368,259 @@ void yyerror(const char *msg) {
     }
 }
 
-int main() {
+static double elapsedMs(std::chrono::steady_clock::time_point from) {
+      return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - from).count();
+}
+
+static long peakRssKb() {
+      struct rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+      return usage.ru_maxrss;
+}
+
+/*
+ * --repeat: compiles the source again and again (lex, parse, check with a fresh
+ * table, free the tree), the way a long-lived process compiling many programs
+ * would. Peak RSS must not move once the first compilation is done.
+ */
+static void repeatCompile(const std::string &source, unsigned workers, const std::vector<Interface> &imports, int times) {
+      fdefNode *first = startFunc;
+      long before = peakRssKb();
+      for (int n = 1; n < times; n++) {
+            FILE *in = fmemopen((void*)source.data(), source.size(), "r");
+            lexerRestart(in);
+            startFunc = NULL;
+            int result;
+            {
+                  AllocPhaseGuard guard(PHASE_PARSING);
+                  result = yyparse();
+            }
+            fclose(in);
+            if (result != 0 || startFunc == NULL) break; // the first compilation parsed the same text
+            {
+                  SymbolTable sym;
+                  sym.workers = workers;
+                  submitBuiltInFunctions(sym);
+                  for (auto &iface : imports)
+                        for (headerNode *h : iface.exports) sym.addFunction(h);
+                  startFunc->semanticCheck(sym);
+            }
+            freeProgram(startFunc);
+      }
+      startFunc = first;
+      fprintf(stderr, "Repeat: %d compilations, peak RSS %ld KB after the first, %ld KB after the last\n", times, before, peakRssKb());
+}
+
+/*
+ * A func_def is streamed when its parent is and it is not inside an if arm or a
+ * loop body; those are checked together with their statement, as in batch mode.
+ */
+void beginFuncDef(headerNode *head) {
+      fNames.push(new fdefNode(head, NULL));
+      bool stream = streamSym && (streaming.empty() || (streaming.back() && blockDepth == 0));
+      streaming.push_back(stream);
+      outerBlocks.push(blockDepth);
+      blockDepth = 0;
+      if (stream) {
+            AllocPhaseGuard guard(PHASE_SEMANTIC);
+            streamEnterFunction(head, *streamSym);
+      }
+}
+
+fdefNode *endFuncDef(stmtNode *body) {
+      fdefNode *def = fNames.top(); // exit/return statements already point at it
+      def->body = body;
+      def->lineno = yylineno;
+      fNames.pop();
+      blockDepth = outerBlocks.top();
+      outerBlocks.pop();
+      if (streaming.back()) {
+            AllocPhaseGuard guard(PHASE_SEMANTIC);
+            streamLeaveFunction(def, *streamSym);
+            freeStmts(def->body); // the header stays: the symbol table still refers to it
+            def->body = NULL;
+      }
+      streaming.pop_back();
+      return def;
+}
+
+void localDefParsed(stmtNode *def) {
+      if (streamSym && streaming.back() && blockDepth == 0) {
+            AllocPhaseGuard guard(PHASE_SEMANTIC);
+            streamLocalDef(def, *streamSym);
+      }
+}
+
+int main(int argc, char **argv) {
+      auto start = std::chrono::steady_clock::now();
       stackinit(); 
       SymbolTable st;
+      bool stats = false;
+      bool stream = false;
+      bool loops = false;
+      bool loopOpt = true;
+      bool vectorize = true;
+      const char *profileGenerate = NULL, *profileUse = NULL;
+      const char *emitPath = NULL;
+      const char *interfacePath = NULL;
+      bool module = false;
+      std::vector<Interface> imports;
+      int allocStats = 0; // 0 = off, 1 = text, 2 = json
+      int repeat = 1;
+      for (int i = 1; i < argc; i++) {
+            if (strncmp(argv[i], "-j", 2) == 0) {
+                  const char *n = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : "1");
+                  st.workers = std::max(1, atoi(n));
+            } else if (strcmp(argv[i], "--stats") == 0) {
+                  stats = true;
+            } else if (strcmp(argv[i], "--stream") == 0) {
+                  stream = true;
+            } else if (strncmp(argv[i], "-fprofile-generate", 18) == 0 && (argv[i][18] == '\0' || argv[i][18] == '=')) {
+                  profileGenerate = argv[i][18] ? argv[i] + 19 : "dana.prof";
+            } else if (strncmp(argv[i], "-fprofile-use", 13) == 0 && (argv[i][13] == '\0' || argv[i][13] == '=')) {
+                  profileUse = argv[i][13] ? argv[i] + 14 : "dana.prof";
+            } else if (strncmp(argv[i], "--emit-c", 8) == 0 && (argv[i][8] == '\0' || argv[i][8] == '=')) {
+                  emitPath = argv[i][8] ? argv[i] + 9 : "a.c";
+            } else if (strncmp(argv[i], "--emit-interface", 16) == 0 && (argv[i][16] == '\0' || argv[i][16] == '=')) {
+                  module = true;
+                  interfacePath = argv[i][16] ? argv[i] + 17 : NULL;
+            } else if (strncmp(argv[i], "--import=", 9) == 0) {
+                  Interface iface;
+                  std::string error;
+                  if (!readInterface(argv[i] + 9, iface, error)) {
+                        fprintf(stderr, RED "Error:" RESET " %s\n", error.c_str());
+                        return 1;
+                  }
+                  imports.push_back(iface);
+            } else if (strcmp(argv[i], "--loop-report") == 0) {
+                  loops = true;
+            } else if (strcmp(argv[i], "-fno-loop-opt") == 0) {
+                  loopOpt = false;
+            } else if (strcmp(argv[i], "-fno-vectorize") == 0) {
+                  vectorize = false;
+            } else if (strcmp(argv[i], "--alloc-stats") == 0 || strcmp(argv[i], "--alloc-stats=text") == 0) {
+                  allocStats = 1;
+            } else if (strcmp(argv[i], "--alloc-stats=json") == 0) {
+                  allocStats = 2;
+            } else if (strncmp(argv[i], "--repeat=", 9) == 0) {
+                  repeat = std::max(1, atoi(argv[i] + 9));
+            } else {
+                  fprintf(stderr, "Usage: %s [-j N] [--stats] [--stream] [--loop-report] [-fno-loop-opt] [-fno-vectorize] [-fprofile-generate[=file]] [-fprofile-use[=file]] [--emit-c[=file]] [--emit-interface[=file]] [--import=file] [--alloc-stats[=text|json]] [--repeat=N] < program.dana\n", argv[0]);
+                  return 1;
+            }
+      }
+      if (stream && (loops || profileGenerate || profileUse || emitPath || module || repeat > 1)) {
+            fprintf(stderr, RED "Error:" RESET " --stream frees function bodies and cannot be combined with passes that need them\n");
+            return 1;
+      }
+      if (stream) streamSym = &st;
       startFunc = NULL;
       fNames = std::stack<fdefNode*>();
+      std::string source;
+      FILE *sourceIn = NULL;
+      if (repeat > 1) { // every compilation lexes the same text
+            char chunk[4096];
+            size_t n;
+            while ((n = fread(chunk, 1, sizeof chunk, stdin)) > 0) source.append(chunk, n);
+            if (!source.empty()) {
+                  sourceIn = fmemopen((void*)source.data(), source.size(), "r");
+                  lexerRestart(sourceIn);
+            }
+      }
 
+      allocSetPhase(PHASE_PRELUDE);
       submitBuiltInFunctions(st);
-      int result = yyparse();
+      for (auto &iface : imports)
+            for (headerNode *h : iface.exports) {
+                  if (st.lookupFunction(h->iden->name)) {
+                        fprintf(stderr, RED "Error:" RESET " '%s' imported from module '%s' is already defined\n", h->iden->name.c_str(), iface.module.c_str());
+                        return 1;
+                  }
+                  st.addFunction(h);
+            }
+      if (module && profileGenerate && emitPath) {
+            fprintf(stderr, RED "Error:" RESET " a module cannot be instrumented with -fprofile-generate\n");
+            return 1;
+      }
+      double startupMs = elapsedMs(start);
 
+      allocSetPhase(PHASE_PARSING);
+      auto phase = std::chrono::steady_clock::now();
+      int result;
+      try {
+            result = yyparse();
+            if (sourceIn) fclose(sourceIn);
+      } catch (const SemanticError &e) { // thrown while parsing only with --stream
+            fprintf(stderr, RED "Error at line %d:" RESET " %s\n" RESET, e.line, e.what());
+            result = 1;
+      }
+      double parseMs = elapsedMs(phase);
+
+      allocSetPhase(PHASE_SEMANTIC);
+      phase = std::chrono::steady_clock::now();
       try {
             if (result == 0 && startFunc != NULL) {
-                  startFunc->semanticCheck(st);
+                  if (!stream) startFunc->semanticCheck(st);
+                  if (repeat > 1) repeatCompile(source, st.workers, imports, repeat);
                   std::cout << GREEN "No semantic errors found." RESET "\n";
+                  if (loops) loopReport(startFunc, std::cout);
+                  Profile profile;
+                  if (profileGenerate || profileUse) {
+                        profile.collect(startFunc);
+                        std::string error;
+                        if (profileUse && !profile.load(profileUse, error)) {
+                              fprintf(stderr, RED "Error:" RESET " %s\n", error.c_str());
+                              result = 1;
+                        } else if (profileUse) {
+                              profile.report(std::cout);
+                        }
+                        // An emitted program writes the real counts itself when it exits.
+                        if (profileGenerate && !emitPath && !profile.save(profileGenerate)) {
+                              fprintf(stderr, RED "Error:" RESET " cannot write profile '%s'\n", profileGenerate);
+                              result = 1;
+                        }
+                  }
+                  Interface iface;
+                  if (module) {
+                        std::string error;
+                        bool changed = false;
+                        std::string path = interfacePath ? interfacePath : startFunc->head->iden->name + ".di";
+                        if (!moduleInterface(startFunc, iface, error) || !writeInterface(path, iface, changed, error)) {
+                              fprintf(stderr, RED "Error:" RESET " %s\n", error.c_str());
+                              result = 1;
+                        } else if (!changed) {
+                              std::cout << "Interface " << path << " unchanged, importers are up to date." << std::endl;
+                        }
+                  }
+                  if (emitPath && result == 0) {
+                        CEmitOptions options;
+                        if (module) options.module = iface.module;
+                        options.imports = &imports;
+                        if (profileGenerate || profileUse) options.profile = &profile;
+                        options.instrument = profileGenerate != NULL;
+                        options.hints = profileUse != NULL;
+                        options.loops = loopOpt;
+                        options.vectorize = vectorize;
+                        if (profileGenerate) options.profilePath = profileGenerate;
+                        std::ofstream out(emitPath);
+                        if (out) emitC(startFunc, out, options);
+                        if (!out) {
+                              fprintf(stderr, RED "Error:" RESET " cannot write '%s'\n", emitPath);
+                              result = 1;
+                        }
+                  }
             }
       } catch (const SemanticError &e) {
             fprintf(stderr, RED "Error at line %d:" RESET " %s\n" RESET, e.line, e.what());
             result = 1;
       }
+      double semanticMs = elapsedMs(phase);
+
+      if (stats) {
+            fprintf(stderr, "Stats: startup %.3f ms, parse %.3f ms, semantic %.3f ms, total %.3f ms, peak RSS %ld KB\n",
+                    startupMs, parseMs, semanticMs, elapsedMs(start), peakRssKb());
+      }
+      if (allocStats) allocReport(stderr, allocStats == 2);
       free(indent_stack);
       return result;
 }
@@ -0,0 +1,169 @@
+#include "profile.hpp"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+void Profile::addSite(const Node *n, SiteKind kind, const std::string &func, int line) {
+    ids[n] = (int)table.size();
+    table.push_back({(int)table.size(), kind, func, line, 0});
+}
+
+void Profile::walk(stmtNode *stmt, const std::string &func) {
+    for (; stmt; stmt = stmt->stmtTail) {
+        if (stmt->stmtType == "def") walkFunc(stmt->funcDef);
+        else if (stmt->stmtType == "loop") {
+            stmtNode *first = stmt->stmtBody;
+            int line = first ? (first->stmtType == "if" && first->ifnode->cond ? first->ifnode->cond->lineno : first->lineno) : stmt->lineno;
+            addSite(stmt, SITE_BACKEDGE, func, line);
+            walk(stmt->stmtBody, func);
+        }
+        else if (stmt->stmtType == "if") {
+            // The statement counts executions of the whole chain; each arm counts the times it was taken.
+            addSite(stmt, SITE_CHAIN, func, stmt->ifnode->cond ? stmt->ifnode->cond->lineno : stmt->lineno);
+            chains[stmt->ifnode] = ids[stmt];
+            for (ifNode *n = stmt->ifnode; n; n = n->tail) {
+                addSite(n, SITE_ARM, func, n->cond ? n->cond->lineno : (n->stmt ? n->stmt->lineno : n->lineno));
+                walk(n->stmt, func);
+            }
+        }
+    }
+}
+
+void Profile::walkFunc(fdefNode *f) {
+    addSite(f, SITE_ENTRY, f->head->iden->name, f->head->lineno);
+    walk(f->body, f->head->iden->name);
+}
+
+void Profile::collect(fdefNode *root) {
+    table.clear();
+    ids.clear();
+    chains.clear();
+    totalEntries = 0;
+    walkFunc(root);
+}
+
+int Profile::siteOf(const Node *n) const {
+    auto it = ids.find(n);
+    return it == ids.end() ? -1 : it->second;
+}
+
+const ProfileSite *Profile::site(const Node *n) const {
+    int id = siteOf(n);
+    return id < 0 ? nullptr : &table[id];
+}
+
+unsigned long long Profile::checksum() const {
+    unsigned long long h = 1469598103934665603ULL; // FNV-1a over the site layout
+    for (auto &s : table) {
+        h = (h ^ (unsigned char)s.kind) * 1099511628211ULL;
+        for (char c : s.func) h = (h ^ (unsigned char)c) * 1099511628211ULL;
+        h *= 1099511628211ULL; // a zero byte ends the name
+        for (int shift = 0; shift < 32; shift += 8) h = (h ^ ((unsigned)s.line >> shift & 0xff)) * 1099511628211ULL;
+    }
+    return h;
+}
+
+bool Profile::save(const std::string &path) const {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "dana-profile 1 " << checksum() << " " << table.size() << "\n";
+    for (auto &s : table)
+        out << s.id << " " << (char)s.kind << " " << s.func << " " << s.line << " " << s.count << "\n";
+    return (bool)out;
+}
+
+bool Profile::load(const std::string &path, std::string &error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open profile '" + path + "'";
+        return false;
+    }
+    std::string magic;
+    int version = 0;
+    unsigned long long sum = 0;
+    size_t count = 0;
+    if (!(in >> magic >> version >> sum >> count) || magic != "dana-profile" || version != 1) {
+        error = "'" + path + "' is not a Dana profile";
+        return false;
+    }
+    if (sum != checksum() || count != table.size()) {
+        error = "profile '" + path + "' does not match this program (stale profile?)";
+        return false;
+    }
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        int id, ln;
+        char kind;
+        std::string func;
+        unsigned long long n;
+        if (!(fields >> id >> kind >> func >> ln >> n) || id < 0 || id >= (int)table.size()) {
+            error = "malformed profile line: " + line;
+            return false;
+        }
+        table[id].count = n;
+    }
+    totalEntries = 0;
+    for (auto &s : table)
+        if (s.kind == SITE_ENTRY) totalEntries = std::max(totalEntries, s.count);
+    return true;
+}
+
+unsigned long long Profile::entryCount(const fdefNode *f) const {
+    const ProfileSite *s = site(f);
+    return s ? s->count : 0;
+}
+
+/* Hot: entered at least a tenth as often as the hottest function. */
+bool Profile::isHot(const fdefNode *f) const {
+    unsigned long long n = entryCount(f);
+    return n > 0 && n * 10 >= totalEntries;
+}
+
+bool Profile::isCold(const fdefNode *f) const {
+    return entryCount(f) == 0;
+}
+
+/* Returns the arm taken at least 90% of the time; the arm count stands for "no arm taken". */
+int Profile::likelyArm(const ifNode *chain) const {
+    auto c = chains.find(chain);
+    if (c == chains.end() || table[c->second].count == 0) return -1;
+    unsigned long long total = table[c->second].count, taken = 0;
+    int arm = 0;
+    for (const ifNode *n = chain; n; n = n->tail, arm++) {
+        const ProfileSite *s = site(n);
+        unsigned long long count = s ? s->count : 0;
+        if (count * 10 >= total * 9) return arm;
+        taken += count;
+    }
+    return taken <= total && (total - taken) * 10 >= total * 9 ? arm : -1;
+}
+
+void Profile::report(std::ostream &out) const {
+    std::vector<const ProfileSite*> funcs;
+    for (auto &s : table) if (s.kind == SITE_ENTRY) funcs.push_back(&s);
+    std::stable_sort(funcs.begin(), funcs.end(), [](const ProfileSite *a, const ProfileSite *b) { return a->count > b->count; });
+
+    out << "Functions by entry count:" << std::endl;
+    for (auto *f : funcs) {
+        const char *tag = f->count == 0 ? "cold" : f->count * 10 >= totalEntries ? "hot" : "warm";
+        out << "  " << f->func << " (line " << f->line << "): " << f->count << " [" << tag << "]" << std::endl;
+    }
+
+    out << "Branches and loops:" << std::endl;
+    unsigned long long chain = 0;
+    for (auto &s : table) {
+        if (s.kind == SITE_BACKEDGE)
+            out << "  " << s.func << " loop (line " << s.line << "): " << s.count << " back-edges" << std::endl;
+        else if (s.kind == SITE_CHAIN) {
+            chain = s.count;
+            out << "  " << s.func << " if (line " << s.line << "): " << s.count << " executions" << std::endl;
+        }
+        else if (s.kind == SITE_ARM) {
+            out << "    arm (line " << s.line << "): " << s.count;
+            if (chain) out << " (" << (s.count * 100 / chain) << "%)";
+            out << std::endl;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ast.hpp"
+
+/*
+ * Profile-guided optimization support. Instrumentation sites are numbered by a
+ * deterministic walk of the checked AST: one counter per function entry, one per
+ * if/elif/else chain and per arm of it, and one per loop back-edge. An instrumented
+ * program writes the counters to a profile file at exit; -fprofile-use reads
+ * them back and turns them into hotness and branch-likelihood hints.
+ */
+
+enum SiteKind {
+    SITE_ENTRY = 'e',
+    SITE_CHAIN = 'c',
+    SITE_ARM = 'b',
+    SITE_BACKEDGE = 'l'
+};
+
+struct ProfileSite {
+    int id;
+    SiteKind kind;
+    std::string func;
+    int line;
+    unsigned long long count;
+};
+
+class Profile {
+public:
+    void collect(fdefNode *root);
+
+    int siteOf(const Node *n) const;  // -1 if the node is not instrumented
+    const ProfileSite *site(const Node *n) const;
+    const std::vector<ProfileSite> &sites() const { return table; }
+    unsigned long long checksum() const;
+
+    bool load(const std::string &path, std::string &error);
+    bool save(const std::string &path) const;
+
+    bool isHot(const fdefNode *f) const;
+    bool isCold(const fdefNode *f) const;
+    int likelyArm(const ifNode *chain) const; // dominant arm, arm count for "none taken", -1 if unbiased
+
+    void report(std::ostream &out) const;
+
+private:
+    void addSite(const Node *n, SiteKind kind, const std::string &func, int line);
+    void walk(stmtNode *stmt, const std::string &func);
+    void walkFunc(fdefNode *f);
+    unsigned long long entryCount(const fdefNode *f) const;
+
+    std::vector<ProfileSite> table;
+    std::unordered_map<const Node*, int> ids;
+    std::unordered_map<const ifNode*, int> chains; // first arm -> chain counter
+    unsigned long long totalEntries = 0;
+};
+
+#endif
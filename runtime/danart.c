@@ -0,0 +1,58 @@
+#include "danart.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void dana_writeInteger(int n) { printf("%d", n); }
+void dana_writeByte(byte b) { printf("%d", b); }
+void dana_writeChar(byte b) { putchar(b); }
+void dana_writeString(const byte *s) { fputs((const char *)s, stdout); }
+
+/* Numeric input consumes the rest of the line, so it mixes with readString. */
+static long readNumber(void) {
+    char line[64];
+    fflush(stdout);
+    if (!fgets(line, sizeof line, stdin)) return 0;
+    size_t len = strlen(line);
+    if (len > 0 && line[len - 1] != '\n') {
+        int c;
+        while ((c = getchar()) != EOF && c != '\n') {}
+    }
+    return strtol(line, NULL, 10);
+}
+
+int dana_readInteger(void) { return (int)readNumber(); }
+byte dana_readByte(void) { return (byte)readNumber(); }
+
+byte dana_readChar(void) {
+    fflush(stdout);
+    int c = getchar();
+    return c == EOF ? 0 : (byte)c;
+}
+
+void dana_readString(int n, byte *s) {
+    int i = 0, c;
+    fflush(stdout);
+    while (i < n - 1 && (c = getchar()) != EOF && c != '\n') s[i++] = (byte)c;
+    if (n > 0) s[i] = '\0';
+}
+
+int dana_extend(byte b) { return b; }
+byte dana_shrink(int i) { return (byte)i; }
+
+int dana_strlen(const byte *s) { return (int)strlen((const char *)s); }
+int dana_strcmp(const byte *s1, const byte *s2) { return strcmp((const char *)s1, (const char *)s2); }
+void dana_strcpy(byte *trg, const byte *src) { strcpy((char *)trg, (const char *)src); }
+void dana_strcat(byte *trg, const byte *src) { strcat((char *)trg, (const char *)src); }
+
+void dana_profile_write(const char *path, unsigned long long checksum, int n, const unsigned long long *counts,
+                        const char *kinds, const char *const *funcs, const int *lines) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "cannot write profile '%s'\n", path);
+        return;
+    }
+    fprintf(f, "dana-profile 1 %llu %d\n", checksum, n);
+    for (int i = 0; i < n; i++) fprintf(f, "%d %c %s %d %llu\n", i, kinds[i], funcs[i], lines[i], counts[i]);
+    fclose(f);
+}
@@ -0,0 +1,65 @@
+#ifndef DANART_H
+#define DANART_H
+
+/* C runtime for programs translated with `dana --emit-c`. */
+
+typedef unsigned char byte;
+
+/* Hints emitted under -fprofile-use. */
+#if defined(__GNUC__)
+#define DANA_LIKELY(c) __builtin_expect(!!(c), 1)
+#define DANA_UNLIKELY(c) __builtin_expect(!!(c), 0)
+#define DANA_HOT __attribute__((hot))
+#define DANA_COLD __attribute__((cold))
+#define DANA_INLINE __attribute__((always_inline)) inline
+#else
+#define DANA_LIKELY(c) (c)
+#define DANA_UNLIKELY(c) (c)
+#define DANA_HOT
+#define DANA_COLD
+#define DANA_INLINE inline
+#endif
+
+/*
+ * Vector kernels: one clone per instruction set, chosen by the dynamic loader
+ * from the CPU's features, and no assumed dependences between iterations.
+ */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define DANA_KERNEL static __attribute__((target_clones("avx2", "sse2", "default")))
+#endif
+#endif
+#ifndef DANA_KERNEL
+#define DANA_KERNEL static
+#endif
+#if defined(__clang__)
+#define DANA_IVDEP _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+#define DANA_IVDEP _Pragma("GCC ivdep")
+#else
+#define DANA_IVDEP
+#endif
+
+void dana_writeInteger(int n);
+void dana_writeByte(byte b);
+void dana_writeChar(byte b);
+void dana_writeString(const byte *s);
+
+int dana_readInteger(void);
+byte dana_readByte(void);
+byte dana_readChar(void);
+void dana_readString(int n, byte *s);
+
+int dana_extend(byte b);
+byte dana_shrink(int i);
+
+int dana_strlen(const byte *s);
+int dana_strcmp(const byte *s1, const byte *s2);
+void dana_strcpy(byte *trg, const byte *src);
+void dana_strcat(byte *trg, const byte *src);
+
+/* Writes the counters of a -fprofile-generate build in the format Profile::load reads. */
+void dana_profile_write(const char *path, unsigned long long checksum, int n, const unsigned long long *counts,
+                        const char *kinds, const char *const *funcs, const int *lines);
+
+#endif
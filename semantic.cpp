@@ -3,6 +3,11 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <array>
 
 bool sameType(typeClass *a, typeClass *b) {
     if (!a || !b) return false;
@@ -29,22 +34,22 @@ void param_semanticCheck(paramNode *node, SymbolTable &sym) {
 }
 
 void if_semanticCheck(ifNode *node, SymbolTable &sym) {
-    if (!node) return;
-    if (node->cond) {
-        typeClass *condType = node->cond->semanticCheck(sym);
-        static basicType boolType(TYPE_BOOL);
-        if (!sameType(condType, &boolType)) throw SemanticError("Condition must be of integer (boolean) type " + typeToString(condType->getType()), node->lineno);
-    }
+    for (; node; node = node->tail) {
+        if (node->cond) {
+            typeClass *condType = node->cond->semanticCheck(sym);
+            static basicType boolType(TYPE_BOOL);
+            static basicType byteType(TYPE_CHAR);
+            if (!sameType(condType, &boolType) && !sameType(condType, &byteType)) throw SemanticError("Condition must be of boolean or byte type, not " + typeToString(condType->getType()), node->lineno);
+        }
 
-    sym.enterScope();
-    stmtNode *stmt = node->stmt;
-    while (stmt) {
-        stmt->semanticCheck(sym);
-        stmt = stmt->stmtTail;
+        sym.enterScope();
+        stmtNode *stmt = node->stmt;
+        while (stmt) {
+            stmt->semanticCheck(sym);
+            stmt = stmt->stmtTail;
+        }
+        sym.exitScope();
     }
-    sym.exitScope();
-
-    if (node->tail) if_semanticCheck(node->tail, sym);
 }
 
 typeClass *exprNode::semanticCheck(SymbolTable &sym) {
@@ -69,6 +74,7 @@ typeClass *exprNode::semanticCheck(SymbolTable &sym) {
             if (!func || !func->iden) throw SemanticError("Invalid function call", this->lineno);
             headerNode *hdr = sym.lookupFunction(func->iden->name);
             if (!hdr) throw SemanticError("Undefined function '" + func->iden->name + "'", this->lineno);
+            func->target = hdr;
 
             std::vector<exprNode *> args = func->args ? *(func->args) : std::vector<exprNode *>();
 
@@ -143,10 +149,7 @@ void stmtNode::semanticCheck(SymbolTable &sym) {
     if (stmtType == "vardecl") {
         if (!varType || !varNames) throw SemanticError("Malformed declaration", this->lineno);
         for (auto &n : *varNames) {
-            if (sym.lookupCurrentScope(n)) {
-                sym.printCurrentScope(std::cout);
-                throw SemanticError("Redeclaration of variable '" + n + "'", this->lineno);
-            }
+            if (sym.lookupCurrentScope(n)) throw SemanticError("Redeclaration of variable '" + n + "'", this->lineno);
             sym.addVariable(n, varType);
         }
     }
@@ -194,130 +197,275 @@ void stmtNode::semanticCheck(SymbolTable &sym) {
     else if (stmtType == "return") { if (exp) exp->semanticCheck(sym); }
     else if (stmtType == "break")  { if (!sym.insideLoop()) throw SemanticError("'break' used outside of any loop", this->lineno); }
     else if (stmtType == "continue") { if (!sym.insideLoop()) throw SemanticError("'continue' used outside of any loop", this->lineno); }
+}
+
+bool isLocalDef(stmtNode *stmt) {
+    return stmt->stmtType == "def" || stmt->stmtType == "decl" || stmt->stmtType == "vardecl";
+}
+
+/* Enters a local definition into the current scope without checking a def's body. */
+void declareLocalDef(stmtNode *stmt, SymbolTable &sym) {
+    if (stmt->stmtType != "def") {
+        stmt->semanticCheck(sym);
+        return;
+    }
+    fdefNode *def = stmt->funcDef;
+    if (!def) throw SemanticError("Function definition missing body", stmt->lineno);
+    if (!def->head || !def->head->iden) throw SemanticError("Invalid function definition", def->lineno);
+    if (!sym.lookupFunction(def->head->iden->name)) sym.addFunction(def->head);
+}
+
+void checkFunctionBody(fdefNode *def, SymbolTable &sym) {
+    sym.enterScope();
+    if (def->head->params) param_semanticCheck(def->head->params, sym);
+    stmtNode *stmt = def->body;
+    while (stmt) {
+        stmt->semanticCheck(sym);
+        stmt = stmt->stmtTail;
+    }
+    sym.exitScope();
+}
+
+/*
+ * Enters every function declared inside a body, in the order checking the body
+ * would: functions stay visible program-wide, so a def's nested functions are
+ * callable by the siblings after it. A decl that clashes is left to the check of
+ * the body that contains it.
+ */
+void declareNested(stmtNode *stmt, SymbolTable &sym) {
+    for (; stmt; stmt = stmt->stmtTail) {
+        if (stmt->stmtType == "def" || stmt->stmtType == "decl") {
+            headerNode *head = stmt->funcDef ? stmt->funcDef->head : nullptr;
+            if (!head || !head->iden) continue;
+            if (!sym.lookupFunction(head->iden->name)) sym.addFunction(head);
+            if (stmt->stmtType == "def") declareNested(stmt->funcDef->body, sym);
+        }
+        else if (stmt->stmtType == "if") {
+            for (ifNode *n = stmt->ifnode; n; n = n->tail) declareNested(n->stmt, sym);
+        }
+        else if (stmt->stmtType == "loop") declareNested(stmt->stmtBody, sym);
+    }
+}
 
-    if (stmtTail) stmtTail->semanticCheck(sym);
+/* A local definition as a sequential check leaves it in the table, nested functions included. */
+void replayLocalDef(stmtNode *stmt, SymbolTable &sym) {
+    declareLocalDef(stmt, sym);
+    if (stmt->stmtType == "def") declareNested(stmt->funcDef->body, sym);
+}
+
+/*
+ * Two-phase check of a function's local definitions. The bodies of its defs are
+ * checked first, by a pool of workers that take defs from a shared counter in
+ * source order. A worker shares the scopes around the function read-only, enters
+ * the function's scope and parameters again in a table of its own, and replays
+ * the local definitions before the def it picked, so every body sees exactly
+ * what a sequential check would. The calling thread then enters the local definitions
+ * into its own table. An error in a body wins over one in a later local
+ * definition, and the earliest body error wins, so diagnostics are deterministic.
+ * Returns the first statement after the local definitions.
+ */
+stmtNode *checkLocalDefs(fdefNode *def, SymbolTable &sym) {
+    stmtNode *stmt = def->body;
+    std::vector<stmtNode*> decls;
+    std::vector<size_t> defs;
+    for (; stmt && isLocalDef(stmt); stmt = stmt->stmtTail) {
+        if (stmt->stmtType == "def") defs.push_back(decls.size());
+        decls.push_back(stmt);
+    }
+
+    std::vector<std::exception_ptr> errors(defs.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        SymbolTable local(sym, sym.depth() - 1);
+        size_t replayed = 0;
+        for (size_t i = next++; i < defs.size(); i = next++) {
+            try {
+                if (local.depth() == 1) {
+                    local.enterScope();
+                    if (def->head->params) param_semanticCheck(def->head->params, local);
+                }
+                for (; replayed < defs[i]; replayed++) replayLocalDef(decls[replayed], local);
+                declareLocalDef(decls[defs[i]], local);
+                checkFunctionBody(decls[defs[i]]->funcDef, local);
+                replayed = defs[i] + 1; // the check entered its nested functions
+            } catch (...) {
+                errors[i] = std::current_exception();
+                return; // whatever this worker checks next comes later in the source
+            }
+        }
+    };
+
+    size_t count = std::min<size_t>(sym.workers, defs.size());
+    std::vector<std::thread> pool;
+    for (size_t w = 0; w < count; ++w) pool.emplace_back(worker);
+    for (auto &t : pool) t.join();
+
+    size_t failed = decls.size();
+    std::exception_ptr pending;
+    for (size_t k = 0; k < decls.size(); ++k) {
+        try {
+            replayLocalDef(decls[k], sym);
+        } catch (...) {
+            pending = std::current_exception();
+            failed = k;
+            break;
+        }
+    }
+    for (size_t i = 0; i < defs.size() && defs[i] < failed; ++i)
+        if (errors[i]) std::rethrow_exception(errors[i]);
+    if (pending) std::rethrow_exception(pending);
+    return stmt;
 }
 
 void fdefNode::semanticCheck(SymbolTable &sym) {
     if (!head || !head->iden) throw SemanticError("Invalid function definition", this->lineno);
     if (!sym.lookupFunction(head->iden->name)) sym.addFunction(head);
+    size_t defs = 0;
+    for (stmtNode *stmt = body; stmt && isLocalDef(stmt); stmt = stmt->stmtTail) defs += stmt->stmtType == "def";
+    if (sym.workers <= 1 || defs < 2) {
+        checkFunctionBody(this, sym);
+        return;
+    }
+
+    sym.enterScope();
+    if (head->params) param_semanticCheck(head->params, sym);
+    stmtNode *stmt = checkLocalDefs(this, sym);
+    while (stmt) {
+        stmt->semanticCheck(sym);
+        stmt = stmt->stmtTail;
+    }
+    sym.exitScope();
+}
 
+/*
+ * Streaming check. The parser calls these as it goes: a function's header and
+ * parameters enter the table when its header is parsed, its var/decl local
+ * definitions as each is reduced, and nested defs have already been checked by
+ * the time they are reduced. Finishing a function then only has to check its
+ * statements, in the same scopes and order as checkFunctionBody.
+ */
+void streamEnterFunction(headerNode *head, SymbolTable &sym) {
+    if (!head || !head->iden) throw SemanticError("Invalid function definition", yylineno);
+    if (!sym.lookupFunction(head->iden->name)) sym.addFunction(head);
     sym.enterScope();
     if (head->params) param_semanticCheck(head->params, sym);
-    if (body) body->semanticCheck(sym);
+}
+
+void streamLocalDef(stmtNode *def, SymbolTable &sym) {
+    if (def->stmtType != "def") def->semanticCheck(sym);
+}
+
+void streamLeaveFunction(fdefNode *def, SymbolTable &sym) {
+    for (stmtNode *stmt = def->body; stmt; stmt = stmt->stmtTail)
+        if (!isLocalDef(stmt)) stmt->semanticCheck(sym);
     sym.exitScope();
 }
 
+/*
+ * The runtime library's signatures. They are static objects, built before main
+ * and shared read-only by every SymbolTable seeded from them. Only the one-name
+ * parameter lists allocate (paramNode holds a std::vector<std::string>), 15
+ * small blocks during static initialization that --alloc-stats reports under
+ * the startup phase. A parameter's ref flag is false from static zero-initialization.
+ */
+static basicType tInt(TYPE_INT);
+static basicType tVoid(TYPE_VOID);
+static basicType tChar(TYPE_CHAR);
+static Const strSize(0);
+static arrayType tStr(&tChar, &strSize);
+
+// decl writeInteger: n as int
+static std::vector<std::string> writeIntegerN{"n"};
+static paramNode writeIntegerP(&writeIntegerN, &tInt, nullptr);
+static Id writeIntegerId("writeInteger");
+static headerNode writeInteger(&tVoid, &writeIntegerP, &writeIntegerId);
+
+// decl writeByte: b as byte
+static std::vector<std::string> writeByteB{"b"};
+static paramNode writeByteP(&writeByteB, &tChar, nullptr);
+static Id writeByteId("writeByte");
+static headerNode writeByte(&tVoid, &writeByteP, &writeByteId);
+
+// decl writeChar: b as byte
+static std::vector<std::string> writeCharB{"b"};
+static paramNode writeCharP(&writeCharB, &tChar, nullptr);
+static Id writeCharId("writeChar");
+static headerNode writeChar(&tVoid, &writeCharP, &writeCharId);
+
+// decl writeString: s as byte []
+static std::vector<std::string> writeStringS{"s"};
+static paramNode writeStringP(&writeStringS, &tStr, nullptr);
+static Id writeStringId("writeString");
+static headerNode writeString(&tVoid, &writeStringP, &writeStringId);
+
+// decl readInteger is int
+static Id readIntegerId("readInteger");
+static headerNode readInteger(&tInt, nullptr, &readIntegerId);
+
+// decl readByte is byte
+static Id readByteId("readByte");
+static headerNode readByte(&tChar, nullptr, &readByteId);
+
+// decl readChar is byte
+static Id readCharId("readChar");
+static headerNode readChar(&tChar, nullptr, &readCharId);
+
+// decl readString: n as int, s as byte []
+static std::vector<std::string> readStringN{"n"}, readStringS{"s"};
+static paramNode readStringP2(&readStringS, &tStr, nullptr);
+static paramNode readStringP(&readStringN, &tInt, &readStringP2);
+static Id readStringId("readString");
+static headerNode readString(&tVoid, &readStringP, &readStringId);
+
+// decl extend is int: b as byte
+static std::vector<std::string> extendB{"b"};
+static paramNode extendP(&extendB, &tChar, nullptr);
+static Id extendId("extend");
+static headerNode extend(&tInt, &extendP, &extendId);
+
+// decl shrink is byte: i as int
+static std::vector<std::string> shrinkI{"i"};
+static paramNode shrinkP(&shrinkI, &tInt, nullptr);
+static Id shrinkId("shrink");
+static headerNode shrink(&tChar, &shrinkP, &shrinkId);
+
+// decl strlen is int: s as byte []
+static std::vector<std::string> strlenS{"s"};
+static paramNode strlenP(&strlenS, &tStr, nullptr);
+static Id strlenId("strlen");
+static headerNode strlenH(&tInt, &strlenP, &strlenId);
+
+// decl strcmp is int: s1 s2 as byte []
+static std::vector<std::string> strcmpS1{"s1"}, strcmpS2{"s2"};
+static paramNode strcmpP2(&strcmpS2, &tStr, nullptr);
+static paramNode strcmpP(&strcmpS1, &tStr, &strcmpP2);
+static Id strcmpId("strcmp");
+static headerNode strcmpH(&tInt, &strcmpP, &strcmpId);
+
+// decl strcpy: trg src as byte []
+static std::vector<std::string> strcpyTrg{"trg"}, strcpySrc{"src"};
+static paramNode strcpyP2(&strcpySrc, &tStr, nullptr);
+static paramNode strcpyP(&strcpyTrg, &tStr, &strcpyP2);
+static Id strcpyId("strcpy");
+static headerNode strcpyH(&tVoid, &strcpyP, &strcpyId);
+
+// decl strcat: trg src as byte []
+static std::vector<std::string> strcatTrg{"trg"}, strcatSrc{"src"};
+static paramNode strcatP2(&strcatSrc, &tStr, nullptr);
+static paramNode strcatP(&strcatTrg, &tStr, &strcatP2);
+static Id strcatId("strcat");
+static headerNode strcatH(&tVoid, &strcatP, &strcatId);
+
+static const std::array<headerNode*, preludeSize> prelude = {
+    &writeInteger, &writeByte, &writeChar, &writeString,
+    &readInteger, &readByte, &readChar, &readString,
+    &extend, &shrink, &strlenH, &strcmpH, &strcpyH, &strcatH,
+};
+
+const std::array<headerNode*, preludeSize> &preludeHeaders() {
+    return prelude;
+}
+
 void submitBuiltInFunctions(SymbolTable &sym) {
-    using std::vector;
-    using std::string;
-
-    auto *tInt   = new basicType(TYPE_INT);
-    auto *tVoid  = new basicType(TYPE_VOID);
-    auto *tChar  = new basicType(TYPE_CHAR);
-    auto *tStr = new arrayType(tChar, new Const(0));
-
-    // decl writeInteger: n as int
-    sym.addFunction(new headerNode(
-        tVoid,
-        new paramNode(new vector<string>{"n"}, tInt, nullptr),
-        new Id("writeInteger")
-    ));
-
-    // decl writeByte: b as byte
-    sym.addFunction(new headerNode(
-        tVoid,
-        new paramNode(new vector<string>{"b"}, tChar, nullptr),
-        new Id("writeByte")
-    ));
-
-    // decl writeChar: b as byte
-    sym.addFunction(new headerNode(
-        tVoid,
-        new paramNode(new vector<string>{"b"}, tChar, nullptr),
-        new Id("writeChar")
-    ));
-
-    // decl writeString: s as byte []
-    sym.addFunction(new headerNode(
-        tVoid,
-        new paramNode(new vector<string>{"s"}, tStr, nullptr),
-        new Id("writeString")
-    ));
-
-    // decl readInteger is int
-    sym.addFunction(new headerNode(
-        tInt, nullptr, new Id("readInteger")
-    ));
-
-    // decl readByte is byte
-    sym.addFunction(new headerNode(
-        tChar, nullptr, new Id("readByte")
-    ));
-
-    // decl readChar is byte
-    sym.addFunction(new headerNode(
-        tChar, nullptr, new Id("readChar")
-    ));
-
-    // decl readString: n as int, s as byte []
-    sym.addFunction(new headerNode(
-        tVoid,
-        new paramNode(
-            new vector<string>{"n"}, tInt,
-            new paramNode(new vector<string>{"s"}, tStr, nullptr)
-        ),
-        new Id("readString")
-    ));
-
-    // decl extend is int: b as byte
-    sym.addFunction(new headerNode(
-        tInt,
-        new paramNode(new vector<string>{"b"}, tChar, nullptr),
-        new Id("extend")
-    ));
-
-    // decl shrink is byte: i as int
-    sym.addFunction(new headerNode(
-        tChar,
-        new paramNode(new vector<string>{"i"}, tInt, nullptr),
-        new Id("shrink")
-    ));
-
-    // decl strlen is int: s as byte []
-    sym.addFunction(new headerNode(
-        tInt,
-        new paramNode(new vector<string>{"s"}, tStr, nullptr),
-        new Id("strlen")
-    ));
-
-    // decl strcmp is int: s1 s2 as byte []
-    sym.addFunction(new headerNode(
-        tInt,
-        new paramNode(
-            new vector<string>{"s1"}, tStr,
-            new paramNode(new vector<string>{"s2"}, tStr, nullptr)
-        ),
-        new Id("strcmp")
-    ));
-
-    // decl strcpy: trg src as byte []
-    sym.addFunction(new headerNode(
-        tVoid,
-        new paramNode(
-            new vector<string>{"trg"}, tStr,
-            new paramNode(new vector<string>{"src"}, tStr, nullptr)
-        ),
-        new Id("strcpy")
-    ));
-
-    // decl strcat: trg src as byte []
-    sym.addFunction(new headerNode(
-        tVoid,
-        new paramNode(
-            new vector<string>{"trg"}, tStr,
-            new paramNode(new vector<string>{"src"}, tStr, nullptr)
-        ),
-        new Id("strcat")
-    ));
-}
\ No newline at end of file
+    for (headerNode *h : preludeHeaders()) sym.addFunction(h);
+}
@@ -1,4 +1,6 @@
 #include "symbol.hpp"
+#include "alloc.hpp"
+#include <algorithm>
 
 /* Types */
 
@@ -60,77 +62,107 @@ void SymbolEntry::print(std::ostream& os) const {
 }
 
 
+SymbolPool::~SymbolPool() {
+    release(0);
+    for (auto *block : blocks) ::operator delete(block);
+}
+
+void SymbolPool::release(size_t mark) {
+    while (used > mark) {
+        used--;
+        blocks[used / blockSize][used % blockSize].~SymbolEntry();
+    }
+}
+
+
 SymbolTable::SymbolTable() { enterScope(); }
 
-SymbolTable::~SymbolTable() {}
+/* Own scope 0 holds the functions this table adds; the shared scopes sit between it and the own scopes above it. */
+SymbolTable::SymbolTable(const SymbolTable& other, size_t depth) : loopDepth(other.loopDepth), shared(&other), sharedDepth(std::min(depth, other.active)) {
+    enterScope();
+}
 
-void SymbolTable::enterScope() { scopes.emplace_back(); }
+SymbolTable::~SymbolTable() {
+    while (active > 0) exitScope();
+}
+
+void SymbolTable::enterScope() {
+    if (active == scopes.size()) scopes.emplace_back();
+    scopes[active++].mark = pool.mark();
+}
 
 void SymbolTable::exitScope() {
-    if (scopes.empty()) throw std::runtime_error("SymbolTable::exitScope() called with no active scope");
-    scopes.pop_back();
+    if (active == 0) throw std::runtime_error("SymbolTable::exitScope() called with no active scope");
+    Scope &scope = scopes[--active];
+    scope.names.clear();
+    pool.release(scope.mark);
 }
 
 void SymbolTable::addVariable(std::string name, typeClass* type, bool isParam) {
-    auto &current = scopes.back();
+    auto &current = scopes[active - 1].names;
     if (current.find(name) != current.end()) {
         throw std::runtime_error("Variable '" + name + "' redeclared in same scope");
     }
-    current[name] = new SymbolEntry(name, type, isParam, false);
+    current[name] = pool.create(name, type, isParam, false);
 }
 
 void SymbolTable::addConstant(std::string name, typeClass* type) {
-    auto &current = scopes.back();
+    auto &current = scopes[active - 1].names;
     if (current.find(name) != current.end()) {
         throw std::runtime_error("Constant '" + name + "' redeclared in same scope");
     }
-    current[name] = new SymbolEntry(name, type, false, true);
+    current[name] = pool.create(name, type, false, true);
 }
 
 void SymbolTable::addFunction(headerNode* h) {
     if (!h || !h->iden) throw std::runtime_error("addFunction() called with invalid header");
     std::string name = h->iden->name;
 
-    auto &globalScope = scopes.front();
-    if (globalScope.find(name) != globalScope.end()) {
+    auto &globalScope = scopes[0].names;
+    if (globalScope.find(name) != globalScope.end() || (shared && shared->scopes[0].names.count(name))) {
         throw std::runtime_error("Function '" + name + "' redeclared");
     }
-    globalScope[name] = new SymbolEntry(name, h);
+    globalScope[name] = functionPool.create(name, h);
+}
+
+/* Innermost first: own scopes, shared scopes, then the functions of both. */
+SymbolEntry* SymbolTable::find(const std::string &name, bool function) const {
+    auto search = [&](const Scope &scope) -> SymbolEntry* {
+        auto it = scope.names.find(name);
+        return it != scope.names.end() && (!function || it->second->isFunction) ? it->second : nullptr;
+    };
+    SymbolEntry *entry = nullptr;
+    for (size_t i = active; i > 1 && !entry; --i) entry = search(scopes[i - 1]);
+    for (size_t i = sharedDepth; i > 1 && !entry; --i) entry = search(shared->scopes[i - 1]);
+    if (!entry && active > 0) entry = search(scopes[0]);
+    if (!entry && sharedDepth > 0) entry = search(shared->scopes[0]);
+    return entry;
 }
 
 SymbolEntry* SymbolTable::lookup(std::string name) {
-    for (int i = (int)scopes.size() - 1; i >= 0; --i) {
-        auto it = scopes[i].find(name);
-        if (it != scopes[i].end()) return it->second;
-    }
-    return nullptr;
+    return find(name, false);
 }
 
 SymbolEntry* SymbolTable::lookupCurrentScope(std::string name) {
-    if (scopes.empty()) return nullptr;
-    auto &current = scopes.back();
+    if (active == 0) return nullptr;
+    auto &current = scopes[active - 1].names;
     auto it = current.find(name);
     if (it != current.end()) return it->second;
     return nullptr;
 }
 
 headerNode* SymbolTable::lookupFunction(std::string name) {
-    for (int i = (int)scopes.size() - 1; i >= 0; --i) {
-        auto it = scopes[i].find(name);
-        if (it != scopes[i].end() && it->second->isFunction) {
-            return it->second->function;
-        }
-    }
-    return nullptr;
+    SymbolEntry *entry = find(name, true);
+    return entry ? entry->function : nullptr;
 }
 
 void SymbolTable::printCurrentScope(std::ostream& os) const {
-    if (scopes.empty()) {
+    if (active == 0) {
         os << "<no active scope>" << std::endl;
         return;
     }
     os << "---- Current Scope ----" << std::endl;
-    for (const auto &pair : scopes.back()) {
+    for (const auto &pair : scopes[active - 1].names) {
         pair.second->print(os);
         os << std::endl;
     }
@@ -138,10 +170,9 @@ void SymbolTable::printCurrentScope(std::ostream& os) const {
 
 void SymbolTable::printAll(std::ostream& os) const {
     os << "==== Symbol Table ====" << std::endl;
-    int level = 0;
-    for (const auto &scope : scopes) {
-        os << "Scope " << level++ << ":" << std::endl;
-        for (const auto &pair : scope) {
+    for (size_t level = 0; level < active; ++level) {
+        os << "Scope " << level << ":" << std::endl;
+        for (const auto &pair : scopes[level].names) {
             pair.second->print(os);
             os << std::endl;
         }
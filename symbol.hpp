@@ -2,10 +2,14 @@
 #define SYMBOL_HPP
 
 #include <vector>
+#include <array>
 #include <string>
 #include <unordered_map>
 #include <stdexcept>
+#include <new>
+#include <utility>
 #include "ast.hpp"
+#include "alloc.hpp"
 
 class Const;
 class headerNode;
@@ -47,6 +51,7 @@ inline std::ostream& operator<<(std::ostream& os, const typeClass& t) {
 
 class basicType : public typeClass {
 public:
+    TRACK_NEW(KIND_BASIC_TYPE)
     basicType(Type t);
     void printNode(std::ostream& os) const override;
     Type getType() const override;
@@ -56,6 +61,7 @@ private:
 
 class arrayType : public typeClass {
 public:
+    TRACK_NEW(KIND_ARRAY_TYPE)
     arrayType(typeClass* baseT, Const *s);
     void printNode(std::ostream& os) const override;
     bool isArray() const override;
@@ -69,6 +75,7 @@ private:
 
 class refType : public typeClass {
 public:
+    TRACK_NEW(KIND_REF_TYPE)
     refType(typeClass *baseT);
     bool isRef() const override;
     Type getType() const override;
@@ -99,9 +106,46 @@ public:
     void print(std::ostream& os) const;
 };
 
+/* Stack-ordered slab for SymbolEntry objects: scopes release their entries in bulk and the blocks are reused. */
+class SymbolPool {
+public:
+    SymbolPool() = default;
+    SymbolPool(const SymbolPool&) = delete;
+    SymbolPool& operator=(const SymbolPool&) = delete;
+    ~SymbolPool();
+
+    template <typename... Args>
+    SymbolEntry* create(Args&&... args) {
+        if (used == blocks.size() * blockSize) {
+            blocks.push_back(static_cast<SymbolEntry*>(::operator new(blockSize * sizeof(SymbolEntry))));
+            TRACK_BLOCK(KIND_SYMBOL_POOL, blockSize * sizeof(SymbolEntry)); // entries reuse slots, so only growth counts
+        }
+        SymbolEntry* e = new (blocks[used / blockSize] + used % blockSize) SymbolEntry(std::forward<Args>(args)...);
+        used++;
+        return e;
+    }
+
+    size_t mark() const { return used; }
+    void release(size_t mark);
+
+private:
+    static const size_t blockSize = 256;
+    std::vector<SymbolEntry*> blocks;
+    size_t used = 0;
+};
+
+/*
+ * Scope 0 holds the functions: a function is visible program-wide once its
+ * header has been entered, whatever scope declares it. Their entries come from
+ * a pool of their own, since they outlive the scope that was open at the time.
+ */
 class SymbolTable {
 public:
     SymbolTable();
+    // reads the first `depth` scopes of `shared`, which must not change while this table is in use
+    SymbolTable(const SymbolTable& shared, size_t depth);
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
     ~SymbolTable();
 
     void enterScope();
@@ -115,7 +159,10 @@ public:
     SymbolEntry* lookupCurrentScope(std::string name);
     headerNode* lookupFunction(std::string name);
 
+    size_t depth() const { return active; }
+
     int loopDepth = 0;
+    unsigned workers = 1; // threads used to check sibling function bodies
 
     void enterLoop() { loopDepth++; }
     void exitLoop()  { if (loopDepth > 0) loopDepth--; }
@@ -125,9 +172,24 @@ public:
     void printAll(std::ostream& os) const;
 
 private:
-    std::vector<std::unordered_map<std::string, SymbolEntry*>> scopes;
+    SymbolEntry* find(const std::string &name, bool function) const;
+
+    struct Scope {
+        std::unordered_map<std::string, SymbolEntry*> names;
+        size_t mark = 0; // pool position when the scope was entered
+    };
+
+    // scopes[active..] are closed scopes kept around so their maps can be reused
+    std::vector<Scope> scopes;
+    size_t active = 0;
+    SymbolPool pool;
+    SymbolPool functionPool;
+    const SymbolTable *shared = nullptr;
+    size_t sharedDepth = 0;
 };
 
 void submitBuiltInFunctions(SymbolTable &sym);
+const size_t preludeSize = 14; // builtins in the runtime library
+const std::array<headerNode*, preludeSize> &preludeHeaders();
 
 #endif
\ No newline at end of file
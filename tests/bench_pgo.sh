@@ -0,0 +1,52 @@
+#!/bin/sh
+# Usage: tests/bench_pgo.sh DANA_BIN [CC] [CFLAGS]
+# For every program in danaLanguage/ and tests/bench/: builds it plain and with
+# -fprofile-generate, runs the instrumented build on <name>.in to record a
+# profile, rebuilds it with -fprofile-use and checks that all three print the
+# same. Reports the best of three runs of each build.
+dana=$1
+cc=${2:-gcc}
+cflags=${3:--O2}
+out=${TMPDIR:-/tmp}/dana_pgo.$$
+status=0
+
+best() { # binary input
+    b=
+    for run in 1 2 3; do
+        start=$(date +%s%N)
+        "$1" < "$2" > "$out.txt" 2>&1
+        end=$(date +%s%N)
+        us=$(( (end - start) / 1000 ))
+        [ -z "$b" ] || [ $us -lt $b ] && b=$us
+    done
+    echo $b
+}
+
+printf "%-16s %13s %13s %13s\n" program plain generate use
+for file in danaLanguage/*.dana tests/bench/*.dana; do
+    name=$(basename "$file" .dana)
+    input=$(dirname "$file")/$name.in
+    [ -f "$input" ] || input=/dev/null
+    $dana --emit-c="$out.plain.c" < "$file" > /dev/null 2>&1 || continue
+    $dana -fprofile-generate="$out.prof" --emit-c="$out.gen.c" < "$file" > /dev/null || { status=1; continue; }
+    for build in plain gen; do
+        $cc $cflags -Iruntime -o "$out.$build" "$out.$build.c" runtime/danart.c || { status=1; continue 2; }
+    done
+    "$out.gen" < "$input" > "$out.gen.txt" 2>&1
+    if ! $dana -fprofile-use="$out.prof" --emit-c="$out.use.c" < "$file" > /dev/null ||
+       ! $cc $cflags -Iruntime -o "$out.use" "$out.use.c" runtime/danart.c; then
+        echo "FAIL (-fprofile-use): $file"
+        status=1
+        continue
+    fi
+    "$out.plain" < "$input" > "$out.plain.txt" 2>&1
+    "$out.use" < "$input" > "$out.use.txt" 2>&1
+    if ! cmp -s "$out.plain.txt" "$out.gen.txt" || ! cmp -s "$out.plain.txt" "$out.use.txt"; then
+        echo "FAIL (builds print different output): $file"
+        status=1
+        continue
+    fi
+    printf "%-16s %10s us %10s us %10s us\n" "$name" $(best "$out.plain" "$input") $(best "$out.gen" "$input") $(best "$out.use" "$input")
+done
+rm -f "$out".*
+exit $status
@@ -0,0 +1,34 @@
+#!/bin/sh
+# Usage: tests/bench_vector.sh DANA_BIN [CC] [CFLAGS]
+# Builds tests/bench/vector.dana with and without -fno-vectorize, checks that
+# both print the same and reports the best of three runs of each and the speedup.
+dana=$1
+cc=${2:-gcc}
+cflags=${3:--O2}
+out=${TMPDIR:-/tmp}/dana_vector.$$
+for mode in vector scalar; do
+    flag=
+    [ $mode = scalar ] && flag=-fno-vectorize
+    $dana $flag --emit-c="$out.$mode.c" < tests/bench/vector.dana > /dev/null || exit 1
+    $cc $cflags -Iruntime -o "$out.$mode" "$out.$mode.c" runtime/danart.c || exit 1
+    best=
+    for run in 1 2 3; do
+        start=$(date +%s%N)
+        "$out.$mode" > "$out.$mode.txt"
+        end=$(date +%s%N)
+        us=$(( (end - start) / 1000 ))
+        [ -z "$best" ] || [ $us -lt $best ] && best=$us
+    done
+    eval "time_$mode=$best"
+done
+status=0
+if ! cmp -s "$out.vector.txt" "$out.scalar.txt"; then
+    echo "FAIL: vector and scalar builds print different output"
+    diff "$out.scalar.txt" "$out.vector.txt"
+    status=1
+fi
+echo "scalar: $time_scalar us"
+echo "vector: $time_vector us"
+awk "BEGIN { printf \"speedup: %.2fx\\n\", $time_scalar / $time_vector }"
+rm -f "$out".*
+exit $status
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Usage: tests/check.sh DANA_BIN
+# Programs in tests/programs must be accepted and those in tests/programs-erroneous
+# rejected, with -j1, -j4 and --stream. All three runs must print the same output.
+dana=$1
+out=${TMPDIR:-/tmp}/dana_check.$$
+status=0
+for file in tests/programs/*.dana tests/programs-erroneous/*.dana; do
+    case $file in
+        tests/programs/*) expect=0 ;;
+        *) expect=1 ;;
+    esac
+    $dana -j1 < "$file" > "$out.ref" 2>&1
+    code=$?
+    if [ $(( code != 0 )) != $expect ]; then
+        if [ $expect = 0 ]; then echo "FAIL (rejected): $file"; else echo "FAIL (accepted): $file"; fi
+        cat "$out.ref"
+        status=1
+    fi
+    for mode in -j4 --stream; do
+        $dana $mode < "$file" > "$out" 2>&1
+        if ! cmp -s "$out" "$out.ref"; then
+            echo "FAIL ($mode differs from -j1): $file"
+            diff "$out.ref" "$out"
+            status=1
+        fi
+    done
+done
+rm -f "$out" "$out.ref"
+[ $status = 0 ] && echo "All checks passed."
+exit $status
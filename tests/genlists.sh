@@ -0,0 +1,39 @@
+#!/bin/sh
+# Usage: tests/genlists.sh KIND N
+# Prints a Dana program with one list of N elements. KIND is one of
+# stmts (statement list), params (parameter list), args (call argument list),
+# ids (identifier list of a var declaration) or elifs (elif chain of an if).
+awk -v kind="$1" -v n="$2" 'BEGIN {
+    print "def main"
+    if (kind == "stmts") {
+        for (i = 0; i < n; i++) print "  skip"
+    } else if (kind == "params") {
+        printf "  def f: p0 as int"
+        for (i = 1; i < n; i++) printf ", p%d as int", i
+        print ""
+        print "    skip"
+        print "  skip"
+    } else if (kind == "args") {
+        printf "  def f:"
+        for (i = 0; i < n; i++) printf " a%d", i
+        print " as int"
+        print "    skip"
+        printf "  f: 0"
+        for (i = 1; i < n; i++) printf ", 0"
+        print ""
+    } else if (kind == "ids") {
+        printf "  var v0"
+        for (i = 1; i < n; i++) printf " v%d", i
+        print " is int"
+        print "  v0 := 0"
+    } else if (kind == "elifs") {
+        print "  var x is int"
+        print "  x := 0"
+        print "  if x = 0: skip"
+        for (i = 1; i < n; i++) printf "  elif x = %d: skip\n", i
+        print "  else: skip"
+    } else {
+        print "genlists.sh: unknown kind " kind > "/dev/stderr"
+        exit 1
+    }
+}'
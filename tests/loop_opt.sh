@@ -0,0 +1,33 @@
+#!/bin/sh
+# Usage: tests/loop_opt.sh DANA_BIN [CC]
+# Translates every program in danaLanguage/ and tests/loops/ to C with and
+# without -fno-loop-opt and fails unless both builds print the same output.
+# Each run gets 10 seconds, so a loop that no longer exits shows as exit 124.
+dana=$1
+cc=${2:-gcc}
+out=${TMPDIR:-/tmp}/dana_loops.$$
+status=0
+for file in danaLanguage/*.dana tests/loops/*.dana; do
+    name=$(basename "$file" .dana)
+    input=$(dirname "$file")/$name.in
+    [ -f "$input" ] || input=/dev/null
+    $dana --emit-c="$out.c" < "$file" > /dev/null 2>&1 || continue
+    $dana -fno-loop-opt --emit-c="$out.ref.c" < "$file" > /dev/null 2>&1
+    if ! $cc -O2 -Iruntime -o "$out" "$out.c" runtime/danart.c || ! $cc -O2 -Iruntime -o "$out.ref" "$out.ref.c" runtime/danart.c; then
+        echo "FAIL (does not build): $file"
+        status=1
+        continue
+    fi
+    timeout 10 "$out" < "$input" > "$out.txt" 2>&1
+    echo "exit $?" >> "$out.txt"
+    timeout 10 "$out.ref" < "$input" > "$out.ref.txt" 2>&1
+    echo "exit $?" >> "$out.ref.txt"
+    if ! cmp -s "$out.txt" "$out.ref.txt"; then
+        echo "FAIL (output differs from -fno-loop-opt): $file"
+        diff "$out.ref.txt" "$out.txt"
+        status=1
+    fi
+done
+rm -f "$out" "$out.c" "$out.txt" "$out.ref" "$out.ref.c" "$out.ref.txt"
+[ $status = 0 ] && echo "Loop optimizations preserve every program's output."
+exit $status
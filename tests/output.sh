@@ -0,0 +1,28 @@
+#!/bin/sh
+# Usage: tests/output.sh DANA_BIN [CC]
+# Translates every program in tests/output/ to C, runs it on <name>.in when
+# present and fails unless it prints exactly <name>.out.
+dana=$1
+cc=${2:-gcc}
+out=${TMPDIR:-/tmp}/dana_output.$$
+status=0
+for file in tests/output/*.dana; do
+    name=tests/output/$(basename "$file" .dana)
+    input=$name.in
+    [ -f "$input" ] || input=/dev/null
+    if ! $dana --emit-c="$out.c" < "$file" > "$out.txt" 2>&1 || ! $cc -O2 -Iruntime -o "$out" "$out.c" runtime/danart.c; then
+        echo "FAIL (does not build): $file"
+        cat "$out.txt"
+        status=1
+        continue
+    fi
+    "$out" < "$input" > "$out.txt" 2>&1
+    if ! cmp -s "$out.txt" "$name.out"; then
+        echo "FAIL (unexpected output): $file"
+        diff "$name.out" "$out.txt"
+        status=1
+    fi
+done
+rm -f "$out" "$out.c" "$out.txt"
+[ $status = 0 ] && echo "All programs printed the expected output."
+exit $status
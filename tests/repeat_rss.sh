@@ -0,0 +1,24 @@
+#!/bin/sh
+# Usage: tests/repeat_rss.sh DANA_BIN [TIMES]
+# Compiles each program TIMES times in one process (--repeat: lex, parse, check
+# and free the tree each time) and fails if peak RSS after the last compilation
+# exceeds peak RSS after the first by more than 1 MB.
+dana=$1
+times=${2:-10000}
+status=0
+for file in tests/programs/*.dana danaLanguage/bubblesort.dana danaLanguage/hanoi.dana danaLanguage/primes.dana; do
+    line=$($dana --repeat=$times < "$file" 2>&1 >/dev/null | grep '^Repeat:')
+    if [ -z "$line" ]; then
+        echo "$file: rejected"
+        status=1
+        continue
+    fi
+    first=$(echo "$line" | sed 's/.*RSS \([0-9]*\) KB after the first.*/\1/')
+    last=$(echo "$line" | sed 's/.*, \([0-9]*\) KB after the last.*/\1/')
+    echo "$file: $times compilations, peak RSS $first KB -> $last KB"
+    if [ "$last" -gt $(( first + 1024 )) ]; then
+        echo "$file: RSS grows with the number of compilations"
+        status=1
+    fi
+done
+exit $status
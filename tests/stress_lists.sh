@@ -0,0 +1,29 @@
+#!/bin/sh
+# Usage: tests/stress_lists.sh DANA_BIN [DIR]
+# Checks programs whose statement, parameter, argument and identifier lists
+# and elif chains have 100k and 1M elements. Fails if a program is rejected or if the 1M run
+# takes more than 15 times as long as the 100k one (linear is 10x, the old
+# quadratic argument list was 100x).
+dana=$1
+dir=${2:-/tmp}
+status=0
+for kind in stmts params args ids elifs; do
+    for n in 100000 1000000; do
+        tests/genlists.sh $kind $n > "$dir/lists_$kind.dana"
+        start=$(date +%s%N)
+        if ! $dana < "$dir/lists_$kind.dana" > "$dir/lists_$kind.out" 2>&1; then
+            echo "$kind $n: rejected"
+            cat "$dir/lists_$kind.out"
+            status=1
+        fi
+        end=$(date +%s%N)
+        eval "t$n=\$(( (end - start) / 1000000 ))"
+    done
+    rm -f "$dir/lists_$kind.dana" "$dir/lists_$kind.out"
+    echo "$kind: 100k ${t100000} ms, 1M ${t1000000} ms"
+    if [ "$t1000000" -gt $(( 15 * t100000 + 50 )) ]; then
+        echo "$kind: not linear"
+        status=1
+    fi
+done
+exit $status